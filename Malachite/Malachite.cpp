@@ -6,11 +6,47 @@
 #include "include/compiler/PseudoByteDecoder.hpp"
 #include "include/compiler/ByteDecoder.hpp"
 #include <vector>
-#include <chrono>
 using namespace MalachiteCore;
 
+//Functions end to end: several functions with locals and recursion. Program divides by zero if the result is wrong
+bool FunctionsCheck()
+{
+	std::string code = R"CODE(
+func fib(int n) -> int
+{
+	if (n < 2): return n
+	int a = fib(n - 1)
+	int b = fib(n - 2)
+	return a + b
+}
+func add(int a, int b) -> int
+{
+	int c = a + b
+	return c
+}
+int f = fib(15)
+int s = add(f, 2)
+int zero = 0
+if (s != 612): s = s / zero
+)CODE";
+	uint16_t errors = Malachite::Logger::Get().GetErrorCounts();
+	Malachite::Lexer lexer;
+	auto tokens = lexer.ToTokens(code);
+	Malachite::ASTBuilder astbuilder;
+	auto tree = astbuilder.BuildAST(tokens);
+	astbuilder.PostprocessTree(tree);
+	Malachite::PseudoByteDecoder pbd;
+	Malachite::ByteDecoder bd;
+	auto program = bd.Pack(bd.PseudoToByte(pbd.GeneratePseudoCode(tree)));
+	if (Malachite::Logger::Get().GetErrorCounts() != errors || program.code.empty()) return false;
+	VMState state;
+	return execute(&state, &program) == VMError::NO_ERROR;
+}
+
 int main()
 {
+	bool functions_check = FunctionsCheck();	//Compiler logs go first
+	std::cout << "FunctionsCheck: " << (functions_check ? "OK" : "FAILED") << "\n";
 	std::string code = R"CODE(
 int x = 100
 int y = 100;
@@ -59,6 +95,7 @@ op_code
 	auto r = pbd.GeneratePseudoCode(tree);
 	Malachite::ByteDecoder bd;
 	auto r1 = bd.PseudoToByte(r);
+	auto program = bd.Pack(r1);
 
 	std::cout << "MalachiteTest--------------------------------\n";
 
@@ -108,16 +145,25 @@ op_code
 		index++;
 	}
 	
-	std::chrono::steady_clock::time_point t = std::chrono::steady_clock::now();
 	VMState state;
-	MalachiteCore::VMError err = execute(&state, r1.data(), r1.size());
-	std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+	VMStats stats;
+	stats.timing_period = 64;
+	state.stats = &stats;
+	VMSamples samples;
+	VMSampler sampler;
+	sampler.attach(&samples);
+	state.samples = &samples;
+	sampler.start();
+	MalachiteCore::VMError err = execute(&state, &program);
+	sampler.stop();
 	if (err)
 	{
 		auto r = state.error_stack.top();
-		std::cout << "Error:" << (uint16_t)err << " " << "IP:" << r.ip << "\n";
+		std::cout << "Error:" << (uint16_t)err << " " << "IP:" << r.ip << " " << "Line:" << program.lines.line(r.ip) << "\n";
 	}
-	std::cout << "Duration : " << std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t) << "\n";
+	std::cout << "Statistics-----------------------------------\n";
+	dump_stats(stats, std::cout, 10, &Malachite::SyntaxInfo::GetByteString);
+	dump_samples_flat(samples, program, std::cout);
 	//std::cout << "Registers dump-------------------------------------\n";
 	//std::cout << "integer\t\t\tunsigned integer\t\t\tdouble\n";
 	//for (int i = 0; i < 10; i++) 
@@ -10,7 +10,7 @@ namespace Malachite
 	{
 		std::vector<Token> tokens;
 		std::vector<ASTNode> children;
-		int line;
+		int line = 0;
 	};
 
 	class ASTBuilder 
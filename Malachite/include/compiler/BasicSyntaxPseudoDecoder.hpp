@@ -25,6 +25,8 @@ namespace Malachite
 		std::vector<PseudoCommand> ParseLoopBlock(const ASTNode& node, std::shared_ptr<CompilationState> state,recursive_handler rh);			//loop cycle
 
 		std::vector<PseudoCommand> ParseCycles(const ASTNode& node, std::shared_ptr<CompilationState> state,recursive_handler rh);
+
+		std::vector<PseudoCommand> ParseFunctionBlock(const ASTNode& node, std::shared_ptr<CompilationState> state, recursive_handler rh);		//func name(type arg, ...) -> type
 	public:
 		std::vector<PseudoCommand> HandleBasicSyntax(const ASTNode& node, std::shared_ptr<CompilationState> state, recursive_handler rh);	//Checks node header content and choouses special method for current node
 	};
@@ -1,5 +1,7 @@
 #pragma once
-#include "..\core\vm.h"
+#include "..\core\program.h"
+#include "..\core\verifier.h"
+#include "ByteOptimizer.hpp"
 #include "CompilationState.hpp"
 #include <bitset>
 #include <stack>
@@ -9,6 +11,10 @@ namespace Malachite
 {
 	constexpr size_t InvalidRegister = SIZE_MAX;
     constexpr int64_t StartDepth = 0;
+    //Calling convention: arguments are passed in the window of last registers, return value is in its first register.
+    //Window isnt allocated for values and isnt saved, another registers written by function are saved by callee
+    constexpr uint64_t CallRegistersCount = 8;
+    constexpr uint64_t CallRegistersStart = MalachiteCore::REGISTER_COUNT - CallRegistersCount;
 
     struct ValueFrame
     {
@@ -57,7 +63,7 @@ namespace Malachite
         RegistersTable() = default;
 
         size_t Allocate() {
-            for (size_t i = 0; i < MalachiteCore::REGISTER_COUNT; i++) {
+            for (size_t i = 0; i < CallRegistersStart; i++) {
                 if (!registers.test(i)) {
                     registers.set(i);
                     return i;
@@ -121,6 +127,33 @@ namespace Malachite
         uint64_t stack_offset = 0;  
     }; 
 
+    struct ScopeInfo
+    {
+        bool frame = true;          //Scope has own frame in the vm data stack (always without flatten_scopes)
+        uint64_t slots_start = 0;   //Frame size at scope start, flattened scope returns it on close: slots of closed scope are reused
+        uint64_t slots_max = 0;     //The biggest frame size of closed nested flattened scopes
+        uint64_t frame_command = 0; //Index of OP_CREATE_FRAME in current_commands, its size is set on close
+        bool call_frame = false;    //Function body: frame is created by OP_CALL, its size is set to calls
+    };
+
+    struct FunctionInfo
+    {
+        uint64_t entry = 0;                 //Index of the first command, OP_CALL jumps here
+        uint64_t skip_jump = 0;             //Index of OP_JMP over the body: declaration doesnt execute it
+        uint64_t frame_size = 0;            //Slots and saved registers, known after DeclareFunctionEnd
+        int64_t depth = StartDepth;         //Depth of function's frame, outer variables are global
+        size_t scope = 0;                   //Index of function's body in scope_stack
+        bool closed = false;
+        std::vector<uint64_t> returns{};    //OP_JMP of returns to the epilogue
+        std::vector<uint64_t> calls{};      //Recursive OP_CALL, frame size is set on close
+    };
+
+    struct ByteDecoderOptions
+    {
+        bool flatten_scopes = true;     //One frame per program/function, nested block scopes (if, loops, {}) take slots in it instead of own frames
+        bool align_slots = true;        //Slots are sorted by size and aligned to it (up to 8), frames and nested scopes start at 8 bytes. Off - declaration order without padding
+    };
+
     struct ByteDecodingState 
     {
         uint64_t ip = 0;
@@ -129,6 +162,10 @@ namespace Malachite
         int64_t current_depth = StartDepth; //Program starts by OpenVisibleScope and ends by CloseVisibleScope, but we need start depth = 0
         std::stack<ValueFrame> value_stack{};         //Stack for operations
         std::stack<uint64_t> frame_size_stack{};    //When we create variable add it size to frame_size stack;
+        std::vector<ScopeInfo> scope_stack{};       //Every open visible scope, frames and flattened ones
+        std::unordered_map<variableID, uint64_t> slot_offsets{};  //Offsets planned by PlanFrameSlots when frame is created (align_slots)
+        std::unordered_map<functionID, FunctionInfo> functions{};   //Declared functions
+        functionID current_function = 0;            //Function which body is decoded, 0 - program
 
         std::unordered_map<variableID, VariableInfo> variable_depth{}; //variableID and info about variable. If we meet DECLARE_VARIABLE -> add writting <ID, Info>
 
@@ -136,6 +173,7 @@ namespace Malachite
         std::unordered_map<uint64_t, std::vector<std::pair<uint64_t, uint64_t>>> waiting_jumps{};  //Label ID, IP (Pseudo,Byte/Native) of jmp commands,
 
         std::vector<MalachiteCore::VMCommand>* current_commands = nullptr;
+        std::vector<size_t> lines{};    //Source line of every command in current_commands (behind it until the handled command is added)
 
     };
 
@@ -143,6 +181,10 @@ namespace Malachite
 	class ByteDecoder		//Pseudo->Byte code
 	{
     private:
+        ByteOptimizerOptions optimizer_options{};
+        ByteDecoderOptions decoder_options{};
+        std::vector<uint64_t> ip_map{};     //Byte ip before peephole pass -> byte ip after it
+        MalachiteCore::LineTable line_table{};  //Byte ip after peephole pass -> source line, Pack attaches it to the program
         //Methods---------------------
         std::vector<MalachiteCore::VMCommand> HandleMemoryCommand(const std::vector<PseudoCommand>& cmds, ByteDecodingState& current_BDS);
         std::vector<MalachiteCore::VMCommand> HandleDeclaringCommand(const std::vector<PseudoCommand>& cmds, ByteDecodingState& current_BDS);
@@ -156,6 +198,14 @@ namespace Malachite
         std::vector<MalachiteCore::VMCommand> HandleControlFlowCommand(const std::vector<PseudoCommand>& cmds, ByteDecodingState& current_BDS);
 
         std::vector<MalachiteCore::VMCommand> HandleCommand(const std::vector<PseudoCommand>& cmds, ByteDecodingState& current_BDS);
+        std::vector<MalachiteCore::VMCommand> HandleScopeCommand(const std::vector<PseudoCommand>& cmds, ByteDecodingState& current_BDS);
+
+        uint64_t GetSlotSize(const Type& type);    //Bytes of variable in frame
+        void PlanFrameSlots(const std::vector<PseudoCommand>& cmds, ByteDecodingState& current_BDS);  //Frame layout of the frame opened at current_BDS.ip
+        MalachiteCore::VMCommand GetLoadCommand(const VariableInfo& info, uint64_t size, uint64_t reg, const ByteDecodingState& current_BDS);    //Variable -> register: local, enclosing or global access
+        MalachiteCore::VMCommand GetStoreCommand(const VariableInfo& info, uint64_t size, uint64_t reg, const ByteDecodingState& current_BDS);   //Register -> variable
+        void CloseFunction(functionID id, ByteDecodingState& current_BDS);  //Epilogue, saving of registers, sizes of frame in calls
+
 
 
 
@@ -167,7 +217,18 @@ namespace Malachite
         MalachiteCore::OpCode GetVMTypedArithmeticCommand(PseudoOpCode code, Type::VMAnalog type); 
 
         MalachiteCore::OpCode GetVMLogicCommand(PseudoOpCode code, Type::VMAnalog type);
+        MalachiteCore::OpCode GetVMFusedJumpCommand(MalachiteCore::OpCode compare, uint64_t flag, bool inverse);    //CMP/DCMP + GET_FLAG(flag) -> OP_JMP_I*/OP_JMP_D*, inverse for JumpNotIf
     public:
         std::vector<MalachiteCore::VMCommand> PseudoToByte(std::pair<std::shared_ptr<CompilationState>, std::vector<PseudoCommand>> state);
+        //Packs wide commands to the runtime form (16 bytes per command + constant pool)
+        MalachiteCore::VMProgram Pack(const std::vector<MalachiteCore::VMCommand>& commands);
+        MalachiteCore::VMProgram PseudoToProgram(std::pair<std::shared_ptr<CompilationState>, std::vector<PseudoCommand>> state);
+
+        void SetOptimizerOptions(const ByteOptimizerOptions& options) { optimizer_options = options; }
+        const ByteOptimizerOptions& GetOptimizerOptions() const { return optimizer_options; }
+        void SetDecoderOptions(const ByteDecoderOptions& options) { decoder_options = options; }
+        const ByteDecoderOptions& GetDecoderOptions() const { return decoder_options; }
+        const std::vector<uint64_t>& GetIpMap() const { return ip_map; }
+        const MalachiteCore::LineTable& GetLineTable() const { return line_table; }
 	};
 }
\ No newline at end of file
@@ -0,0 +1,40 @@
+#pragma once
+#include "..\core\program.h"
+#include <bitset>
+#include <vector>
+
+namespace Malachite
+{
+	struct ByteOptimizerOptions
+	{
+		bool enabled = true;
+		bool remove_nops = true;			//OP_NOP placeholders (GetConversionCommand and etc)
+		bool remove_jumps_to_next = true;	//Jumps to the next command
+		bool forward_stores = true;			//STORE_LOCAL slot, rX + LOAD_LOCAL rY, slot -> STORE_LOCAL + MOV_RR rY, rX (the same for ENCLOSING, 8 bytes values only)
+		bool collapse_moves = true;			//OP a <- ... + MOV_RR b, a -> OP b <- ... if a isnt used later, MOV_RR a, a is removed
+		size_t max_iterations = 8;			//Patterns are repeated while something changes
+	};
+
+	class ByteOptimizer		//Peephole pass over ByteDecoder output, jump targets are remapped after removals
+	{
+	private:
+		using RegisterSet = std::bitset<MalachiteCore::REGISTER_COUNT>;
+
+		ByteOptimizerOptions options;
+		std::vector<uint64_t> ip_map;	//Old ip -> new ip, ip_map[old size] is the new size
+
+		std::vector<bool> FindJumpTargets(const std::vector<MalachiteCore::VMCommand>& commands);
+		std::vector<RegisterSet> ComputeLiveOut(const std::vector<MalachiteCore::VMCommand>& commands);
+
+		bool ForwardStores(std::vector<MalachiteCore::VMCommand>& commands, std::vector<bool>& removed, const std::vector<bool>& jump_targets);
+		bool CollapseMoves(std::vector<MalachiteCore::VMCommand>& commands, std::vector<bool>& removed, const std::vector<bool>& jump_targets);
+		bool MarkUseless(const std::vector<MalachiteCore::VMCommand>& commands, std::vector<bool>& removed);
+
+		std::vector<MalachiteCore::VMCommand> Compact(const std::vector<MalachiteCore::VMCommand>& commands, const std::vector<bool>& removed, std::vector<uint64_t>& step_map);
+	public:
+		ByteOptimizer(ByteOptimizerOptions options = ByteOptimizerOptions()) : options(options) {}
+
+		std::vector<MalachiteCore::VMCommand> Optimize(const std::vector<MalachiteCore::VMCommand>& commands);
+		const std::vector<uint64_t>& GetIpMap() const { return ip_map; }
+	};
+}
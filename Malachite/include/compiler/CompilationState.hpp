@@ -2,6 +2,7 @@
 #include <unordered_map>
 #include <vector>
 #include "Definitions.hpp"
+#include "..\core\host.h"
 #include <stdexcept>
 #include <memory>
 namespace Malachite 
@@ -44,9 +45,10 @@ namespace Malachite
 		functionID function_id{};
 		std::string name{};
 		std::vector<Variable> args{};	//      
+		uint64_t host_index = MalachiteCore::HostRegistry::INVALID_INDEX;	//Function of the embedder (OP_CALL_HOST), it hasnt byte code
 		Function(const std::string& name, typeID return_type, std::vector<Variable>& args) : function_id(GetGlobalID()), name(name), args(args), return_type(return_type){}
 		Function() : return_type(0), function_id(0), name("function") { args = {}; }
-		Function(const Function& other) : function_id(other.function_id), name(other.name), return_type(other.return_type)
+		Function(const Function& other) : function_id(other.function_id), name(other.name), return_type(other.return_type), host_index(other.host_index)
 		{
 			args = other.args;
 		}
@@ -281,6 +283,32 @@ namespace Malachite
 			vf->functions_table.AddFunction(function);
 			functions_global_table.emplace(function.function_id, Function(function));	//adds to global_table
 		}
+		//Functions of the embedder are global, calls are resolved to their indices in registry
+		void AddHostFunctions(const MalachiteCore::HostRegistry& registry)
+		{
+			for (uint64_t index = 0; index < registry.size(); index++)
+			{
+				const MalachiteCore::HostSignature& signature = registry.signature(index);
+				std::vector<Variable> args;
+				for (size_t i = 0; i < signature.arguments.size(); i++)
+				{
+					args.push_back(Variable("arg" + std::to_string(i), GetHostType(signature.arguments[i])));
+				}
+				Function function(registry.name(index), GetHostType(signature.result), args);
+				function.host_index = index;
+				AddFunctionToSpace(1, function);
+			}
+		}
+		typeID GetHostType(MalachiteCore::HostType type)
+		{
+			switch (type)
+			{
+			case MalachiteCore::HostType::INT: return FindType(SyntaxInfoKeywords::Get().typemarker_int)->type_id;
+			case MalachiteCore::HostType::UINT: return FindType(SyntaxInfoKeywords::Get().typemarker_uint)->type_id;
+			case MalachiteCore::HostType::DOUBLE: return FindType(SyntaxInfoKeywords::Get().typemarker_float)->type_id;
+			default: return FindType(SyntaxInfoKeywords::Get().typemarker_void)->type_id;
+			}
+		}
 		void AddTypeToCurrentSpace(Type& type)
 		{
 			VisibleFrame* vf = GetCurrentSpace();
@@ -226,7 +226,7 @@ namespace Malachite
         START_SECTION_DECLARING_OPS,
         DeclareVariable,    //Declaring of variable, parameters are name and vm_type (double/int64/uint64), but creating writting in variable table with fact type (string and another)
         DeclareFunction,    //Declaring of function, parameters are name and return type_id, code after DeclareFunction and OpenVisibleScope is function body.
-        DeclareFunctionEnd,
+        DeclareFunctionEnd, //After CloseVisibleScope of function's body, parameter is function's id
         END_SECTION_DECLARING_OPS,
         //Arithmetic
         START_SECTION_ARITHMETIC_OPS,
@@ -289,6 +289,7 @@ namespace Malachite
     {
         PseudoOpCode op_code{};
         std::unordered_map<std::string, TokenValue> parameters{}; //Example,  op_code: DeclareVariable, parameters: name-"x"
+        size_t line = 0;    //Source line of the statement, set by PseudoByteDecoder (0 - unknown)
     };
 
     struct SyntaxInfoKeywords //If want custom keywords on russian - use koi-8
@@ -504,6 +505,7 @@ namespace Malachite
                 {PseudoOpCode::Label, "Label"},
                 {PseudoOpCode::DeclareVariable, "DeclareVariable"},
                 {PseudoOpCode::DeclareFunction, "DeclareFunction"},
+                {PseudoOpCode::DeclareFunctionEnd, "DeclareFunctionEnd"},
                 {PseudoOpCode::Add, "Add"},
                 {PseudoOpCode::Subtract, "Subtract"},
                 {PseudoOpCode::Multiplication, "Multiplication"},
@@ -599,6 +601,8 @@ namespace Malachite
                 {MalachiteCore::OP_LOAD_ENCLOSING_R, "OP_LOAD_ENCLOSING_R"},
                 {MalachiteCore::OP_ALLOCATE_MEMORY, "OP_ALLOCATE_MEMORY"},
                 {MalachiteCore::OP_FREE_MEMORY, "OP_FREE_MEMORY"},
+                {MalachiteCore::OP_LOAD_STACK, "OP_LOAD_STACK"},
+                {MalachiteCore::OP_STORE_STACK, "OP_STORE_STACK"},
 
                 // Control flow [91-120]
                 {MalachiteCore::OP_JMP, "OP_JMP"},
@@ -607,6 +611,19 @@ namespace Malachite
                 {MalachiteCore::OP_CALL, "OP_CALL"},
                 {MalachiteCore::OP_RET, "OP_RET"},
                 {MalachiteCore::OP_HALT, "OP_HALT"},
+                {MalachiteCore::OP_JMP_IEQ, "OP_JMP_IEQ"},
+                {MalachiteCore::OP_JMP_INE, "OP_JMP_INE"},
+                {MalachiteCore::OP_JMP_IGT, "OP_JMP_IGT"},
+                {MalachiteCore::OP_JMP_ILT, "OP_JMP_ILT"},
+                {MalachiteCore::OP_JMP_IGE, "OP_JMP_IGE"},
+                {MalachiteCore::OP_JMP_ILE, "OP_JMP_ILE"},
+                {MalachiteCore::OP_JMP_DEQ, "OP_JMP_DEQ"},
+                {MalachiteCore::OP_JMP_DNE, "OP_JMP_DNE"},
+                {MalachiteCore::OP_JMP_DGT, "OP_JMP_DGT"},
+                {MalachiteCore::OP_JMP_DLT, "OP_JMP_DLT"},
+                {MalachiteCore::OP_JMP_DGE, "OP_JMP_DGE"},
+                {MalachiteCore::OP_JMP_DLE, "OP_JMP_DLE"},
+                {MalachiteCore::OP_CALL_HOST, "OP_CALL_HOST"},
 
                 // System Calls [121]
                 {MalachiteCore::OP_SYSTEM_CALL, "OP_SYSTEM_CALL"},
@@ -617,7 +634,57 @@ namespace Malachite
                 {MalachiteCore::OP_TC_UITD_R, "OP_TC_UITD_R"},
                 {MalachiteCore::OP_TC_UITI_R, "OP_TC_UITI_R"},
                 {MalachiteCore::OP_TC_DTUI_R, "OP_TC_DTUI_R"},
-                {MalachiteCore::OP_TC_ITUI_R, "OP_TC_ITUI_R"}
+                {MalachiteCore::OP_TC_ITUI_R, "OP_TC_ITUI_R"},
+
+                // Width-specialized memory [128-191]
+                {MalachiteCore::OP_LOAD_RM_U8, "OP_LOAD_RM_U8"},
+                {MalachiteCore::OP_LOAD_RM_U16, "OP_LOAD_RM_U16"},
+                {MalachiteCore::OP_LOAD_RM_U32, "OP_LOAD_RM_U32"},
+                {MalachiteCore::OP_LOAD_RM_U64, "OP_LOAD_RM_U64"},
+                {MalachiteCore::OP_STORE_MR_U8, "OP_STORE_MR_U8"},
+                {MalachiteCore::OP_STORE_MR_U16, "OP_STORE_MR_U16"},
+                {MalachiteCore::OP_STORE_MR_U32, "OP_STORE_MR_U32"},
+                {MalachiteCore::OP_STORE_MR_U64, "OP_STORE_MR_U64"},
+                {MalachiteCore::OP_PUSH_U8, "OP_PUSH_U8"},
+                {MalachiteCore::OP_PUSH_U16, "OP_PUSH_U16"},
+                {MalachiteCore::OP_PUSH_U32, "OP_PUSH_U32"},
+                {MalachiteCore::OP_PUSH_U64, "OP_PUSH_U64"},
+                {MalachiteCore::OP_POP_U8, "OP_POP_U8"},
+                {MalachiteCore::OP_POP_U16, "OP_POP_U16"},
+                {MalachiteCore::OP_POP_U32, "OP_POP_U32"},
+                {MalachiteCore::OP_POP_U64, "OP_POP_U64"},
+                {MalachiteCore::OP_LOAD_LOCAL_U8, "OP_LOAD_LOCAL_U8"},
+                {MalachiteCore::OP_LOAD_LOCAL_U16, "OP_LOAD_LOCAL_U16"},
+                {MalachiteCore::OP_LOAD_LOCAL_U32, "OP_LOAD_LOCAL_U32"},
+                {MalachiteCore::OP_LOAD_LOCAL_U64, "OP_LOAD_LOCAL_U64"},
+                {MalachiteCore::OP_STORE_LOCAL_U8, "OP_STORE_LOCAL_U8"},
+                {MalachiteCore::OP_STORE_LOCAL_U16, "OP_STORE_LOCAL_U16"},
+                {MalachiteCore::OP_STORE_LOCAL_U32, "OP_STORE_LOCAL_U32"},
+                {MalachiteCore::OP_STORE_LOCAL_U64, "OP_STORE_LOCAL_U64"},
+                {MalachiteCore::OP_STORE_ENCLOSING_A_U8, "OP_STORE_ENCLOSING_A_U8"},
+                {MalachiteCore::OP_STORE_ENCLOSING_A_U16, "OP_STORE_ENCLOSING_A_U16"},
+                {MalachiteCore::OP_STORE_ENCLOSING_A_U32, "OP_STORE_ENCLOSING_A_U32"},
+                {MalachiteCore::OP_STORE_ENCLOSING_A_U64, "OP_STORE_ENCLOSING_A_U64"},
+                {MalachiteCore::OP_LOAD_ENCLOSING_A_U8, "OP_LOAD_ENCLOSING_A_U8"},
+                {MalachiteCore::OP_LOAD_ENCLOSING_A_U16, "OP_LOAD_ENCLOSING_A_U16"},
+                {MalachiteCore::OP_LOAD_ENCLOSING_A_U32, "OP_LOAD_ENCLOSING_A_U32"},
+                {MalachiteCore::OP_LOAD_ENCLOSING_A_U64, "OP_LOAD_ENCLOSING_A_U64"},
+                {MalachiteCore::OP_STORE_ENCLOSING_R_U8, "OP_STORE_ENCLOSING_R_U8"},
+                {MalachiteCore::OP_STORE_ENCLOSING_R_U16, "OP_STORE_ENCLOSING_R_U16"},
+                {MalachiteCore::OP_STORE_ENCLOSING_R_U32, "OP_STORE_ENCLOSING_R_U32"},
+                {MalachiteCore::OP_STORE_ENCLOSING_R_U64, "OP_STORE_ENCLOSING_R_U64"},
+                {MalachiteCore::OP_LOAD_ENCLOSING_R_U8, "OP_LOAD_ENCLOSING_R_U8"},
+                {MalachiteCore::OP_LOAD_ENCLOSING_R_U16, "OP_LOAD_ENCLOSING_R_U16"},
+                {MalachiteCore::OP_LOAD_ENCLOSING_R_U32, "OP_LOAD_ENCLOSING_R_U32"},
+                {MalachiteCore::OP_LOAD_ENCLOSING_R_U64, "OP_LOAD_ENCLOSING_R_U64"},
+                {MalachiteCore::OP_LOAD_STACK_U8, "OP_LOAD_STACK_U8"},
+                {MalachiteCore::OP_LOAD_STACK_U16, "OP_LOAD_STACK_U16"},
+                {MalachiteCore::OP_LOAD_STACK_U32, "OP_LOAD_STACK_U32"},
+                {MalachiteCore::OP_LOAD_STACK_U64, "OP_LOAD_STACK_U64"},
+                {MalachiteCore::OP_STORE_STACK_U8, "OP_STORE_STACK_U8"},
+                {MalachiteCore::OP_STORE_STACK_U16, "OP_STORE_STACK_U16"},
+                {MalachiteCore::OP_STORE_STACK_U32, "OP_STORE_STACK_U32"},
+                {MalachiteCore::OP_STORE_STACK_U64, "OP_STORE_STACK_U64"}
             };
             return OpCodeToString;
         }
@@ -644,6 +711,7 @@ namespace Malachite
                 {"PRINT_DOUBLE", MalachiteCore::SysCall::PRINT_DOUBLE},
                 {"PRINT_CHAR", MalachiteCore::SysCall::PRINT_CHAR},
                 {"PRINT_CHAR_ARRAY", MalachiteCore::SysCall::PRINT_CHAR_ARRAY},
+                {"FLUSH", MalachiteCore::SysCall::FLUSH},
             };
 
             return StringToOpCodeConstant;
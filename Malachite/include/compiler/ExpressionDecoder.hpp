@@ -58,6 +58,8 @@ namespace Malachite
 		std::vector<PseudoCommand>	ProcessRightSide(const std::vector<Token>& right, ExpressionState& es);
 		//assign
 		std::vector<PseudoCommand>	DecodeAssignExpression(const std::vector<Token>& right, const std::vector<Token>& left, ExpressionState& es);
+		//return
+		std::vector<PseudoCommand>	DecodeReturnExpression(const std::vector<Token>& tokens, ExpressionState& es);	//return [value]
 
 		//Postfix
 		std::vector<PseudoCommand>	PTP_HandleFunctionCall(const std::vector<TokensGroup>& postfix, ExpressionState& es);	//PTP-PostfixToPseude (Help method)
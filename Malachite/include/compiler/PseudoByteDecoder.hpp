@@ -13,7 +13,10 @@ namespace Malachite
 
 		BasicSyntaxPseudoDecoder bs_decoder;
 
+		const MalachiteCore::HostRegistry* host_registry = nullptr;
 	public:
+		//Names of registry's functions are callable as global functions, VMState::hosts has to be the same registry
+		void SetHostRegistry(const MalachiteCore::HostRegistry* registry) { host_registry = registry; }
 		std::pair<std::shared_ptr<CompilationState>,std::vector<PseudoCommand>> GeneratePseudoCode(const ASTNode& node);
 		std::pair<std::shared_ptr<CompilationState>, std::vector<PseudoCommand>> GeneratePseudoCode(const std::vector<ASTNode>& node);
 	};
@@ -18,7 +18,12 @@ namespace MalachiteCore
         //MEMORY
         MEMORY_ACCESS_VIOLATION,
         STACK_OVERFLOW,
-        STACK_UNDERFLOW
+        STACK_UNDERFLOW,
+        HEAP_OUT_OF_MEMORY,     //OP_ALLOCATE_MEMORY: no free block with this size
+        INVALID_HEAP_POINTER,   //OP_FREE_MEMORY: not an allocated block (or double free)
+
+        YIELD,      //execute_slice: budget is spent or stop is requested, execution can be continued
+        HOST_FUNCTION_INVALID,  //OP_CALL_HOST: index isnt in VMState::hosts or count of arguments differs
     };
 
     constexpr uint8_t ERROR_STACK_SIZE = 255;
@@ -1,5 +1,9 @@
 ﻿#pragma once
-#include "vm.h"
+#include "program.h"
+#include "host.h"
+#include "stats.h"
+#include "sampler.h"
+#include <atomic>
 
 
 namespace MalachiteCore 
@@ -14,521 +18,46 @@ namespace MalachiteCore
 		return ValueType::ANY;  // tagged
 	}
 
-	VMError execute(VMState* state, VMCommand* commands, size_t commands_size);
-
-    inline VMError arithmetic_handler(VMState* state, VMCommand* command)
-    {
-
-		switch (command->operation)
-		{
-		case OP_IADD_RRR:
-			state->registers[command->destination].i = state->registers[command->source0].i + state->registers[command->source1].i;
-			break;
-		case OP_ISUB_RRR:
-			state->registers[command->destination].i = state->registers[command->source0].i - state->registers[command->source1].i;
-			break;
-		case OP_IMUL_RRR:
-			state->registers[command->destination].i = state->registers[command->source0].i * state->registers[command->source1].i;
-			break;
-		case OP_IDIV_RRR:
-			if (state->registers[command->source1].i == 0) return VMError::ZERO_DIVISION;
-			state->registers[command->destination].i = state->registers[command->source0].i / state->registers[command->source1].i;
-			break;
-		case OP_IMOD_RRR:
-			state->registers[command->destination].i = state->registers[command->source0].i % state->registers[command->source1].i;
-			break;
-		case OP_INEG_RR:
-			state->registers[command->destination].i = -state->registers[command->source0].i;
-			break;
-		case OP_UADD_RRR:
-			state->registers[command->destination].u = state->registers[command->source0].u + state->registers[command->source1].u;
-			break;
-		case OP_USUB_RRR:
-			state->registers[command->destination].u = state->registers[command->source0].u - state->registers[command->source1].u;
-			break;
-		case OP_UMUL_RRR:
-			state->registers[command->destination].u = state->registers[command->source0].u * state->registers[command->source1].u;
-			break;
-		case OP_UDIV_RRR:
-			if (state->registers[command->source1].u == 0) return VMError::ZERO_DIVISION;
-			state->registers[command->destination].u = state->registers[command->source0].u / state->registers[command->source1].u;
-			break;
-		case OP_UMOD_RRR:
-			state->registers[command->destination].u = state->registers[command->source0].u % state->registers[command->source1].u;
-			break;
-		case OP_DADD_RRR:
-			state->registers[command->destination].d = state->registers[command->source0].d + state->registers[command->source1].d;
-			break;
-		case OP_DSUB_RRR:
-			state->registers[command->destination].d = state->registers[command->source0].d - state->registers[command->source1].d;
-			break;
-		case OP_DMUL_RRR:
-			state->registers[command->destination].d = state->registers[command->source0].d * state->registers[command->source1].d;
-			break;
-		case OP_DDIV_RRR:
-			if (state->registers[command->source1].d == 0) return VMError::ZERO_DIVISION;
-			state->registers[command->destination].d = state->registers[command->source0].d / state->registers[command->source1].d;
-			break;
-		case OP_DNEG_RR:
-			state->registers[command->destination].d = -state->registers[command->source0].d;
-			break;
-
-		default:
-			break;
-		}
-
-        return VMError::NO_ERROR;
-    }
-
-	inline VMError memory_handler(VMState* state, VMCommand* command)
+	// Compile-time features of the interpreter loop. Every combination is a separate loop, disabled features have no runtime branches
+	template<bool Checked, bool Profile, bool Trace, bool Budget, bool Sample = false>
+	struct ExecutionPolicy
 	{
-		switch (command->operation)
-		{
-		case OpCode::OP_LOAD_RM:
-			if (command->source0 > MAX_MEMORY_SIZE - command->source1 ||
-				command->source1 == 0 || command->source1 > REGISTER_SIZE) {
-				return VMError::MEMORY_ACCESS_VIOLATION;
-			}
-
-			state->registers[command->destination].u = 0;
-			for (int i = 0; i < command->source1; i++)
-			{
-				// Takes byte from memory
-				uint8_t byte = state->memory[command->source0 + i];
-				// Little-endian: little byte in little address
-				state->registers[command->destination].u |= (static_cast<uint64_t>(byte) << (i * 8));
-			}
-			break;
-
-		case OpCode::OP_STORE_MR:
-		{
-			if (command->destination > MAX_MEMORY_SIZE - command->source1 ||
-				command->source1 == 0 || command->source1 > REGISTER_SIZE) {
-				return VMError::MEMORY_ACCESS_VIOLATION;
-			}
-
-			for (int i = 0; i < command->source1; i++)
-			{
-				// Little-endian: takes bytes from little to big
-				uint8_t byte = (state->registers[command->source0].u >> (i * 8)) & 0xFF;
-				state->memory[command->destination + i] = byte;
-			}
-			break;
-		}
-		case OpCode::OP_MOV_RR:
-			state->registers[command->destination].i = state->registers[command->source0].i;
-			break;
-		case OpCode::OP_MOV_RI_INT:
-			state->registers[command->destination].i = command->immediate.i;
-			break;
-		case OpCode::OP_MOV_RI_UINT:
-			state->registers[command->destination].u = command->immediate.u;
-			break;
-		case OpCode::OP_MOV_RI_DOUBLE:
-			state->registers[command->destination].d = command->immediate.d;
-			break;
-		case OpCode::OP_CREATE_FRAME:
-		{
-			state->data_stack.push(DataFrame{ state->fp, state->sp });
-			state->fp = state->sp;
-			break;
-		}
-		case OpCode::OP_DESTROY_FRAME:
-		{
-			if (state->data_stack.empty()) {
-				return VMError::STACK_UNDERFLOW;
-			}
-			DataFrame df = state->data_stack.pop();
-			state->fp = df.fp;
-			state->sp = df.sp;
-			break;
-		}
-		case OpCode::OP_DESTROY_FRAMES:
-		{
-			if (command->destination > state->data_stack.size()) {
-				return VMError::STACK_UNDERFLOW; // Early check
-			}
-			DataFrame last_df;
-			for (uint64_t i = 0; i < command->destination; i++) {
-				last_df = state->data_stack.pop();  // Запоминаем только последний
-			}
-
-			state->fp = last_df.fp;  // Восстанавливаем из ПОСЛЕДНЕГО
-			state->sp = last_df.sp;
-		}
-		break;
-		case OpCode::OP_PUSH: // dest-size(source0) source0-reg_from 
-		{
-			// command->destination = data's size (1, 2, 4, 8 bytes)
-			// command->source0 = регистр-источник
-
-			state->sp -= command->destination;  // сдвигаем SP на размер данных
-			// Записываем данные из регистра в стек
-			for (int i = 0; i < command->destination; i++) {
-				uint8_t byte = (state->registers[command->source0].u >> (i * 8)) & 0xFF;
-				state->memory[state->sp + i] = byte;
-			}
-			break;
-		}
-
-		case OpCode::OP_POP: // dest-reg_to source0-size(source0)  
-		{
-			// command->source0 = размер данных (сколько байт читать)
-			// command->destination = регистр-назначение
-
-			// Читаем данные из стека в регистр
-			uint64_t value = 0;
-			for (int i = 0; i < command->source0; i++) {
-				uint8_t byte = state->memory[state->sp + i];
-				value |= static_cast<uint64_t>(byte) << (i * 8);
-			}
-			state->registers[command->destination].u = value;
-
-			state->sp += command->source0;  // сдвигаем SP обратно
-
-			break;
-		}
-		case OpCode::OP_LOAD_LOCAL:
-		{
-			uint64_t offset = command->source0;
-			// Проверяем, что offset не слишком большой
-			if (offset > state->fp) {
-				return VMError::MEMORY_ACCESS_VIOLATION;
-			}
-			uint64_t address = state->fp - offset;
-			uint64_t size = command->source1;  // или command->source1, если переменный размер
-			if (address > STACK_START || address - size < STACK_END) {
-				return VMError::MEMORY_ACCESS_VIOLATION;
-			}
-			state->registers[command->destination].u = 0;
-
-			uint64_t start_position = address - size + 1;
-
-			for (int i = 0; i < size; i++) {
-				uint8_t byte = state->memory[start_position + i];
-				state->registers[command->destination].u |= (static_cast<uint64_t>(byte) << (i * 8));
-			}
-			break;
-		}
-		case OpCode::OP_STORE_LOCAL:
-		{
-			uint64_t offset = command->destination;
-			if (offset > state->fp || state->fp - offset < STACK_END) {
-				return VMError::MEMORY_ACCESS_VIOLATION;
-			}
-			uint64_t size = command->source1;
-			uint64_t address = state->fp - offset;
-			if (address > STACK_START || address - size < STACK_END) {
-				return VMError::MEMORY_ACCESS_VIOLATION;
-			}
-
-			uint64_t start_position = address - size + 1;
-
-			for (int i = 0; i < size; i++) {
-				uint8_t byte = (state->registers[command->source0].u >> (i * 8)) & 0xFF;
-				state->memory[start_position + i] = byte;
-			}
-			break;
-		}
-		case OpCode::OP_STORE_ENCLOSING_A:
-		{
-			// destination[memory-offset] source0[register] source1[depth]
-			uint64_t offset_val = command->destination;    // смещение в целевом фрейме
-			uint64_t src_reg = command->source0;           // регистр-источник данных  
-			uint64_t size_and_depth = command->source1;             // размер переменной и глубина (сколько фреймов от начала)
-
-			uint64_t size = size_and_depth >> 32;
-			uint64_t depth = size_and_depth & 0xFFFFFFFF;  //0b0000000000000000000000000000000011111111111111111111111111111111;
-			
-			// Находим нужный фрейм через data_stack
-			if (depth>= state->data_stack.size()) {
-				return VMError::STACK_UNDERFLOW;
-			}
-
-			const DataFrame& target_frame = state->data_stack.at(depth);	
-			uint64_t target_fp = target_frame.fp;
-
-			// Проверяем границы стека для целевого фрейма
-			if (offset_val > target_fp || target_fp - offset_val < STACK_END) {
-				return VMError::MEMORY_ACCESS_VIOLATION;
-			}
-
-			uint64_t address = target_fp - offset_val;
-
-			if (address < STACK_END || address > STACK_START || address - size < STACK_END) {
-				return VMError::MEMORY_ACCESS_VIOLATION;
-			}
-
-			// Записываем данные из регистра-источника
-			uint64_t start_position = address - size + 1;
-			for (int i = 0; i < size; i++) {
-				uint8_t byte = (state->registers[src_reg].u >> (i * 8)) & 0xFF;
-				state->memory[start_position + i] = byte;
-			}
-			break;
-		}
-
-		case OpCode::OP_LOAD_ENCLOSING_A:
-		{
-			// destination[register] source0[memory-offset] source1[depth]
-			uint64_t dest_reg = command->destination;      // регистр-назначение
-			uint64_t offset_val = command->source0;        // смещение в целевом фрейме
-			uint64_t size_and_depth = command->source1;             // размер переменной и глубина (сколько фреймов от начала)
-
-			uint64_t size = size_and_depth >> 32;
-			uint64_t depth = size_and_depth & 0xFFFFFFFF;  //0b0000000000000000000000000000000011111111111111111111111111111111;
-			if (depth >= state->data_stack.size()) {
-				return VMError::STACK_UNDERFLOW;
-			}
-			const DataFrame& target_frame = state->data_stack.at(depth);
-			uint64_t target_fp = target_frame.fp;
-
-			if (offset_val > target_fp || target_fp - offset_val < STACK_END) {
-				return VMError::MEMORY_ACCESS_VIOLATION;
-			}
-
-			uint64_t address = target_fp - offset_val;
-
-			if (address < STACK_END || address > STACK_START || address - size < STACK_END) {
-				return VMError::MEMORY_ACCESS_VIOLATION;
-			}
-
-			// Читаем данные в регистр-назначение
-			uint64_t start_position = address - size + 1;
-			uint64_t value = 0;
-			for (int i = 0; i < size; i++) {
-				uint8_t byte = state->memory[start_position + i];
-				value |= static_cast<uint64_t>(byte) << (i * 8);
-			}
-			state->registers[dest_reg].u = value;
-			break;
-		}
-		case OpCode::OP_STORE_ENCLOSING_R:
-		{
-			// destination[memory-offset] source0[register] source1[depth]
-			uint64_t offset_val = command->destination;    // смещение в целевом фрейме
-			uint64_t src_reg = command->source0;           // регистр-источник данных  
-			uint64_t size_and_depth = command->source1;             // размер переменной и глубина (сколько фреймов вверх)
-
-			uint64_t size = size_and_depth >> 32;
-			uint64_t depth = size_and_depth & 0xFFFFFFFF;  //0b0000000000000000000000000000000011111111111111111111111111111111;
-			// Находим нужный фрейм через data_stack
-			if (depth >= state->data_stack.size()) {
-				return VMError::STACK_UNDERFLOW;
-			}
-
-			const DataFrame& target_frame = state->data_stack.at(state->data_stack.size() - 1 - depth);
-			uint64_t target_fp = target_frame.fp;
-
-			// Проверяем границы стека для целевого фрейма
-			if (offset_val > target_fp || target_fp - offset_val < STACK_END) {
-				return VMError::MEMORY_ACCESS_VIOLATION;
-			}
-
-			uint64_t address = target_fp - offset_val;
-
-			if (address < STACK_END || address > STACK_START || address - size < STACK_END) {
-				return VMError::MEMORY_ACCESS_VIOLATION;
-			}
-
-			// Записываем данные из регистра-источника
-			uint64_t start_position = address - size + 1;
-			for (int i = 0; i < size; i++) {
-				uint8_t byte = (state->registers[src_reg].u >> (i * 8)) & 0xFF;
-				state->memory[start_position + i] = byte;
-			}
-			break;
-		}
-
-		case OpCode::OP_LOAD_ENCLOSING_R:
-		{
-			// destination[register] source0[memory-offset] source1[depth]
-			uint64_t dest_reg = command->destination;      // регистр-назначение
-			uint64_t offset_val = command->source0;        // смещение в целевом фрейме
-			uint64_t size_and_depth = command->source1;             // размер переменной и глубина (сколько фреймов вверх)
-
-			uint64_t size = size_and_depth >> 32;
-			uint64_t depth = size_and_depth & 0xFFFFFFFF;  //0b0000000000000000000000000000000011111111111111111111111111111111;
-			if (depth >= state->data_stack.size()) {
-				return VMError::STACK_UNDERFLOW;
-			}
-
-			const DataFrame& target_frame = state->data_stack.at(state->data_stack.size() - 1 - depth);
-			uint64_t target_fp = target_frame.fp;
-
-			if (offset_val > target_fp || target_fp - offset_val < STACK_END) {
-				return VMError::MEMORY_ACCESS_VIOLATION;
-			}
-
-			uint64_t address = target_fp - offset_val;
-
-			if (address < STACK_END || address > STACK_START || address - size < STACK_END) {
-				return VMError::MEMORY_ACCESS_VIOLATION;
-			}
-
-			// Читаем данные в регистр-назначение
-			uint64_t start_position = address - size + 1;
-			uint64_t value = 0;
-			for (int i = 0; i < size; i++) {
-				uint8_t byte = state->memory[start_position + i];
-				value |= static_cast<uint64_t>(byte) << (i * 8);
-			}
-			state->registers[dest_reg].u = value;
-			break;
-		}
-		default:
-			break;
-		}
-
-		return VMError::NO_ERROR;
-	}
-	inline VMError logic_handler(VMState* state, VMCommand* command)
+		static constexpr bool checked = Checked;	//Runtime bounds checks, off only for programs passed verify_program
+		static constexpr bool profile = Profile;	//Counts commands into ExecutionOptions::profile and VMState::stats
+		static constexpr bool trace = Trace;		//Calls ExecutionOptions::trace before every command
+		static constexpr bool budget = Budget;		//Time slice by ExecutionOptions::budget and stop_request (execute_slice)
+		static constexpr bool sample = Sample;		//Takes samples into VMState::samples when VMSampler arms them (sampler.h)
+	};
+	using DefaultPolicy = ExecutionPolicy<true, false, false, false>;
+
+	//State is saved (ip, sp, fp, flags) before the call, command is the one at state->ip
+	using TraceCallback = void(*)(void* user_data, const VMState* state, const PackedCommand& command);
+
+	struct ExecutionOptions
 	{
-		switch (command->operation)
-		{
-		case OpCode::OP_AND_RRR:
-			state->registers[command->destination].i = state->registers[command->source0].i != 0 && state->registers[command->source1].i != 0;		//AND first bit
-			break;
-		case OpCode::OP_OR_RRR:
-			state->registers[command->destination].i = state->registers[command->source0].i != 0 || state->registers[command->source1].i != 0;      //OR first bit
-			break;
-		case OpCode::OP_NOT_RR:
-			state->registers[command->destination].i = !(state->registers[command->source0].i != 0);
-			break;
-
-		case OpCode::OP_BIT_AND_RRR:
-			state->registers[command->destination].i = state->registers[command->source0].i & state->registers[command->source1].i;      //OR first bit
-			break;
-		case OpCode::OP_BIT_OR_RRR:
-			state->registers[command->destination].i = state->registers[command->source0].i | state->registers[command->source1].i;
-			break;
-		case OpCode::OP_BIT_NOT_RR:
-			state->registers[command->destination].i = ~(state->registers[command->source0].i);
-			break;
-		case OpCode::OP_BIT_OFFSET_LEFT_RRR:
-		{
-			state->registers[command->destination].i = state->registers[command->source0].i << state->registers[command->source1].i;
-			break;
-		}
-		case OpCode::OP_BIT_OFFSET_RIGHT_RRR:
-		{
-			state->registers[command->destination].i = state->registers[command->source0].i >> state->registers[command->source1].i;
-			break;
-		}
-		case OpCode::OP_CMP_RR:
-		{
-			//Reset logic flags state
-			state->flags &= ~(FLAG::EQUAL_FLAG | FLAG::LESS_FLAG | FLAG::GREATER_FLAG);
-
-			if (state->registers[command->source0].i == state->registers[command->source1].i) {
-				state->flags |= FLAG::EQUAL_FLAG;
-			}
-			else if (state->registers[command->source0].i > state->registers[command->source1].i)
-			{
-				state->flags |= FLAG::GREATER_FLAG | NOT_EQUAL_FLAG;
-			}
-			else // < CASE
-			{
-				state->flags |= FLAG::LESS_FLAG | NOT_EQUAL_FLAG;
-			}
-			break;
-		}
-		case OpCode::OP_DCMP_RR:
-		{
-			//Reset logic flags state
-			state->flags &= ~(FLAG::EQUAL_FLAG | FLAG::NOT_EQUAL_FLAG | FLAG::LESS_FLAG | FLAG::GREATER_FLAG);
-
-			auto is_nan = [](double value) -> bool {
-				uint64_t bits = *reinterpret_cast<const uint64_t*>(&value);
-				uint64_t exponent = (bits >> 52) & 0x7FF;  // 11 bits for exponent
-				uint64_t mantissa = bits & 0xFFFFFFFFFFFFF; // 52 bits for mantissa
-				return (exponent == 0x7FF) && (mantissa != 0);
-				};
-			if (is_nan(state->registers[command->source0].d) || is_nan(state->registers[command->source1].d)) {
-				// NaN detected - don't set comparison flags
-				return VMError::NAN_FLOAT_VALUE;
-			}
-			if (state->registers[command->source0].d == state->registers[command->source1].d) {
-				state->flags |= FLAG::EQUAL_FLAG;
-			}
-			else if (state->registers[command->source0].d > state->registers[command->source1].d)
-			{
-				state->flags |= FLAG::GREATER_FLAG | NOT_EQUAL_FLAG;
-			}
-			else // < CASE
-			{
-				state->flags |= FLAG::LESS_FLAG | NOT_EQUAL_FLAG;
-			}
-			break;
-		}	
-		case OpCode::OP_GET_FLAG: //destination - register, source0 - flag type (check FLAG enum)
-			{
-				FLAG flag = (FLAG)command->source0;	// uint64_t -> uint32_t
-				state->registers[command->destination].u = state->flags & flag;	//Flag combinations: EQUAL | GREATER
-			}
-			break;
-		}
-		
-		return VMError::NO_ERROR;
-	}
-
-	inline VMError control_flow_handler(VMState* state, VMCommand* command)
-	{
-		switch (command->operation)
-		{
-		case OpCode::OP_JMP:
-			state->ip = command->destination;
-			state->flags |= FLAG::JUMPED_FLAG;
-			break;
-
-		case OpCode::OP_JMP_CV:
-			if (state->registers[command->source0].u != 0) {
-				state->ip = command->destination;
-				state->flags |= FLAG::JUMPED_FLAG;
-			}
-			break;
-		case OpCode::OP_JMP_CNV:
-			if (state->registers[command->source0].u == 0) {
-				state->ip = command->destination;
-				state->flags |= FLAG::JUMPED_FLAG;
-			}
-			break;
-		case OpCode::OP_CALL:
-			// Используем только call_stack для управления вызовами
-			if (state->call_stack.size() >= CALL_STACK_SIZE) {
-				return VMError::STACK_OVERFLOW;
-			}
-
-			// Сохраняем возвратный адрес в call_stack
-			state->call_stack.push(CallFrame{ state->ip + 1 });
-
-			// Переходим к функции
-			state->ip = command->destination;
-			state->flags |= FLAG::JUMPED_FLAG;
-			break;
-
-		case OpCode::OP_RET:
-		{
-			if (state->call_stack.empty()) {
-				return VMError::STACK_UNDERFLOW;
-			}
-
-			CallFrame frame = state->call_stack.pop();
-			state->ip = frame.return_ip;
-			state->flags |= FLAG::JUMPED_FLAG;		//WARNING Maybe its not useful here, must be tested later 
-			break;
-		}
-		case OpCode::OP_HALT:
-			return VMError::EXIT;
-			break;
-		default:
-			break;
-		}
-
-		return VMError::NO_ERROR;
-	}
-
+		VMProfile* profile = nullptr;
+		TraceCallback trace = nullptr;
+		void* trace_data = nullptr;
+		uint64_t budget = 0;		//0 - unlimited
+		const std::atomic<bool>* stop_request = nullptr;	//Budget policy is on when budget or stop_request is set (cancellation only if budget is 0)
+	};
+
+	//Main entry: runs packed program from 0 or, if the state was stopped by HALT, from the next command
+	VMError execute(VMState* state, const VMProgram* program);
+	//Selects the loop once by options: profile is on when options.profile or state->stats is set, sample when state->samples is set, trace when set,
+	//checks are off for a verified program started from the beginning
+	VMError execute(VMState* state, const VMProgram* program, const ExecutionOptions& options);
+	//Loop with fixed policy. Returns VMCS_INVALID if Policy needs something options or program dont have
+	//(unchecked loop for not verified program or resumed state, profile or trace without target)
+	template<typename Policy>
+	VMError execute(VMState* state, const VMProgram* program, const ExecutionOptions& options);
+	//Wide commands are packed on each call, use VMProgram for repeated runs
+	VMError execute(VMState* state, VMCommand* commands, size_t commands_size);
+	//Executes one command at state->ip (STOPPED_FLAG isnt checked), state->ip is moved to the next command
+	VMError execute_step(VMState* state, const VMProgram* program);
+	//Time slice: returns YIELD when budget (about count of commands) is spent or stop_request is set, next call continues from the same place.
+	//Both are checked on backward jumps and calls only. Budget 0 is unlimited: the run yields only by stop_request
+	VMError execute_slice(VMState* state, const VMProgram* program, uint64_t budget, const std::atomic<bool>* stop_request = nullptr);
 
-	VMError syscalls_handler(VMState* state, VMCommand* command);
-	VMError special_handler(VMState* state, VMCommand* command);
+	VMError syscalls_handler(VMState* state, const PackedCommand* command);
 }
\ No newline at end of file
@@ -0,0 +1,95 @@
+#pragma once
+#include "vm.h"
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace MalachiteCore
+{
+    enum class HostType : uint8_t
+    {
+        VOID,       //Result only
+        INT,        //int64_t, Register::i
+        UINT,       //uint64_t, Register::u
+        DOUBLE,     //double, Register::d
+    };
+
+    struct HostSignature
+    {
+        HostType result = HostType::VOID;
+        std::vector<HostType> arguments{};
+    };
+
+    // Arguments are registers [arguments, arguments + count) as they are (no conversion), result is written to arguments[0].
+    // state is saved before the call (ip, sp, fp), only memory and written ranges (heap_high_water, stack_low_water) can be changed.
+    // Error is pushed to error_stack as errors of commands
+    using HostFunction = VMError(*)(VMState* state, Register* arguments, void* user_data);
+
+    // Entry of the table used by OP_CALL_HOST
+    struct HostEntry
+    {
+        HostFunction function = nullptr;
+        void* user_data = nullptr;
+        uint64_t arguments = 0;     //Count, checked against OP_CALL_HOST source1 by every loop
+    };
+
+    namespace HostDetail
+    {
+        template<typename T> struct Argument;
+        template<> struct Argument<int64_t> { static constexpr HostType type = HostType::INT; static int64_t get(const Register& reg) { return reg.i; } };
+        template<> struct Argument<uint64_t> { static constexpr HostType type = HostType::UINT; static uint64_t get(const Register& reg) { return reg.u; } };
+        template<> struct Argument<double> { static constexpr HostType type = HostType::DOUBLE; static double get(const Register& reg) { return reg.d; } };
+        template<> struct Argument<void> { static constexpr HostType type = HostType::VOID; };
+
+        template<auto Function, typename F = decltype(Function)> struct Thunk;
+        template<auto Function, typename R, typename... Args>
+        struct Thunk<Function, R(*)(Args...)>
+        {
+            static HostSignature signature() { return HostSignature{ Argument<R>::type, { Argument<Args>::type... } }; }
+
+            template<size_t... Indices>
+            static void invoke(Register* arguments, std::index_sequence<Indices...>)
+            {
+                if constexpr (std::is_void_v<R>) Function(Argument<Args>::get(arguments[Indices])...);
+                else arguments[0] = Register(Function(Argument<Args>::get(arguments[Indices])...));    //Arguments are read before result is written
+            }
+            static VMError call(VMState*, Register* arguments, void*)
+            {
+                invoke(arguments, std::index_sequence_for<Args...>());
+                return VMError::NO_ERROR;
+            }
+        };
+    }
+
+    // Functions of the embedder, called by OP_CALL_HOST with index of the function in the table.
+    // Compiler resolves names to indices (PseudoByteDecoder::SetHostRegistry), VMState::hosts has to point to the same registry at run.
+    // Functions arent added while a VM runs with the registry: table can be moved
+    class HostRegistry
+    {
+    public:
+        static constexpr uint64_t INVALID_INDEX = UINT64_MAX;
+
+        //Returns index of the function, INVALID_INDEX if name is taken, function is nullptr or an argument is VOID
+        uint64_t add(const std::string& name, const HostSignature& signature, HostFunction function, void* user_data = nullptr);
+        //Typed C++ function (int64_t, uint64_t, double arguments and result, void result): arguments are taken from registers by generated thunk
+        template<auto Function>
+        uint64_t add(const std::string& name) {
+            using Thunk = HostDetail::Thunk<Function>;
+            return add(name, Thunk::signature(), &Thunk::call);
+        }
+
+        uint64_t find(const std::string& name) const;     //INVALID_INDEX if there isnt
+        const std::string& name(uint64_t index) const { return m_names[index]; }
+        const HostSignature& signature(uint64_t index) const { return m_signatures[index]; }
+
+        const HostEntry* entries() const { return m_entries.data(); }
+        size_t size() const { return m_entries.size(); }
+    private:
+        std::vector<HostEntry> m_entries{};
+        std::vector<std::string> m_names{};
+        std::vector<HostSignature> m_signatures{};
+        std::unordered_map<std::string, uint64_t> m_indices{};
+    };
+}
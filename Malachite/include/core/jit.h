@@ -0,0 +1,44 @@
+#pragma once
+#include "program.h"
+
+//Native tier is built only for x86-64, another targets run JITProgram by interpreter
+#ifndef MALACHITE_JIT
+#if defined(__x86_64__) || defined(_M_X64)
+#define MALACHITE_JIT 1
+#else
+#define MALACHITE_JIT 0
+#endif
+#endif
+
+namespace MalachiteCore
+{
+    // Template JIT: every command is translated to a prewritten piece of x86-64 code.
+    // Native code reaches registers, memory, fp and flags through the VMState pointer (pinned in rbx),
+    // commands without template (frames, calls, system calls and etc) return to the host and run by execute_step.
+    struct JITProgram
+    {
+        using Entry = uint64_t(*)(VMState* state, uint64_t ip);    //Returns JIT exit code: reason, error and ip
+
+        VMProgram program{};        //Copy for fallback commands
+        void* code = nullptr;       //Executable buffer (read + execute after compilation)
+        size_t code_size = 0;
+        Entry entry = nullptr;      //nullptr -> program is interpreted
+        size_t native_commands = 0; //Commands with native template
+
+        JITProgram() = default;
+        JITProgram(const JITProgram&) = delete;
+        JITProgram& operator=(const JITProgram&) = delete;
+        JITProgram(JITProgram&& other) noexcept;
+        JITProgram& operator=(JITProgram&& other) noexcept;
+        ~JITProgram();
+
+        void Release();
+    };
+
+    bool jit_available();
+    // Translates program to native code. If native tier isnt available, jit.entry stays nullptr and program is interpreted
+    VMError jit_compile(const VMProgram* program, JITProgram& jit);
+    VMError jit_compile(const VMCommand* commands, size_t commands_size, JITProgram& jit);
+    // Same contract as execute: resumes after OP_HALT by STOPPED_FLAG, errors are pushed to error_stack
+    VMError execute_jit(VMState* state, const JITProgram* jit);
+}
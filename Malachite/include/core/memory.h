@@ -0,0 +1,74 @@
+#pragma once
+#include "vmstructs.h"
+#include <vector>
+
+namespace MalachiteCore
+{
+    // Memory layout of one VMState: heap [0, heap_size), stack [heap_size, heap_size + stack_size) grows down from the top
+    struct MemoryConfig
+    {
+        size_t heap_size = HEAP_SIZE;
+        size_t stack_size = STACK_SIZE;
+        bool huge_pages = false;    //Hint, used only if memory is big enough (HUGE_PAGES_MIN_SIZE), ignored if system refuses
+
+        size_t memory_size() const { return heap_size + stack_size; }
+    };
+
+    constexpr size_t HUGE_PAGES_MIN_SIZE = 2 * 1024 * 1024;
+    constexpr size_t DISCARD_MIN_SIZE = 256 * 1024;     //Bigger ranges are zeroed by returning pages to system, not by memset
+
+    struct MemoryRange
+    {
+        size_t offset = 0;
+        size_t size = 0;
+    };
+
+    // Immutable copy of VM memory. Memory of forks is mapped from it copy-on-write: memfd on Linux, pagefile section on Windows.
+    // Another systems keep only the saved ranges and copy them to every fork
+    class MemoryImage
+    {
+    private:
+        size_t m_size = 0;
+        size_t m_mapped = 0;
+        int m_fd = -1;
+        void* m_section = nullptr;
+        std::vector<MemoryRange> m_ranges{};    //Copy fallback
+        std::vector<uint8_t> m_bytes{};
+
+        friend class VMMemory;
+    public:
+        MemoryImage(const uint8_t* data, size_t size, const std::vector<MemoryRange>& ranges);    //Bytes out of ranges are zero. std::bad_alloc if fails
+        MemoryImage(const MemoryImage&) = delete;
+        MemoryImage& operator=(const MemoryImage&) = delete;
+        ~MemoryImage();
+
+        size_t size() const { return m_size; }
+        bool shared_pages() const { return m_fd >= 0 || m_section != nullptr; }
+    };
+
+    // Anonymous mapping: pages are committed (and zeroed by system) on first touch, so untouched memory costs nothing.
+    // Mapping of MemoryImage is private: written pages are copied, another ones stay shared with the image
+    class VMMemory
+    {
+    private:
+        uint8_t* m_data = nullptr;
+        size_t m_size = 0;      //Requested size
+        size_t m_mapped = 0;    //Size of mapping (rounded to pages)
+        bool m_view = false;    //Mapped from MemoryImage: discarded pages would return to image bytes, not to zero
+
+    public:
+        VMMemory() = default;
+        explicit VMMemory(size_t size, bool huge_pages = false);    //std::bad_alloc if mapping fails
+        explicit VMMemory(const MemoryImage& image);
+        VMMemory(const VMMemory&) = delete;
+        VMMemory& operator=(const VMMemory&) = delete;
+        VMMemory(VMMemory&& other) noexcept;
+        VMMemory& operator=(VMMemory&& other) noexcept;
+        ~VMMemory();
+
+        uint8_t* data() const { return m_data; }
+        size_t size() const { return m_size; }
+        void zero(size_t offset, size_t size);
+        void release();
+    };
+}
@@ -55,15 +55,15 @@ namespace MalachiteCore
         //OP_LS
         // ... 60
 
-        // Memory [61-80]
+        // Memory [61-90]
         OP_LOAD_RM = 61,    //register-destination,             address loading from - source0, size [1-8 bytes] - source1
         OP_STORE_MR,        //Address saving to-destination,    register - source0,             size [1-8 bytes] - source1
         OP_MOV_RR,
-        OP_MOV_RI_INT,          //Integer
-        OP_MOV_RI_UINT,         //Unsigned integer
-        OP_MOV_RI_DOUBLE,       //Double
+        OP_MOV_RI_INT,          //Integer               packed: source0[int32 immediate]
+        OP_MOV_RI_UINT,         //Unsigned integer      packed: source0[uint32 immediate]
+        OP_MOV_RI_DOUBLE,       //Double                packed: always OP_MOV_RC
 
-        OP_CREATE_FRAME,
+        OP_CREATE_FRAME,        //destination[size of frame's variables (not register)], reserved below the new frame pointer
         OP_DESTROY_FRAME,
         OP_DESTROY_FRAMES,      //destination (count)
 
@@ -72,21 +72,40 @@ namespace MalachiteCore
         OP_LOAD_LOCAL,          //destination[register]            source[memory-offset]          source1[size in bytes]  
         OP_STORE_LOCAL,         //destination[memory-offset]       source[register]               source1[size in bytes]  
         // A - absolute, r - relatively
-        OP_STORE_ENCLOSING_A,     //destination[memory-offset]       source0[register]              source1[size and depth] size - 32 little bits, depth - 32 big bits       we store variable to n frame at start
-        OP_LOAD_ENCLOSING_A,      //destination[register]            source0[memory-offset]         source1[size and depth] size - 32 little bits, depth - 32 big bits       we load variable from n frame at start
-        OP_STORE_ENCLOSING_R,     //destination[memory-offset]       source0[register]              source1[size and depth] size - 32 little bits, depth - 32 big bits       we store variable to n frame from top
-        OP_LOAD_ENCLOSING_R,      //destination[register]            source0[memory-offset]         source1[size and depth] size - 32 little bits, depth - 32 big bits       we load variable from n frame  from top
+        OP_STORE_ENCLOSING_A,     //destination[memory-offset]       source0[register]              source1[size and depth] size - 32 big bits, depth - 32 little bits (packed: 8/24)       we store variable to n frame at start
+        OP_LOAD_ENCLOSING_A,      //destination[register]            source0[memory-offset]         source1[size and depth] size - 32 big bits, depth - 32 little bits (packed: 8/24)       we load variable from n frame at start
+        OP_STORE_ENCLOSING_R,     //destination[memory-offset]       source0[register]              source1[size and depth] size - 32 big bits, depth - 32 little bits (packed: 8/24)       we store variable to n frame from top
+        OP_LOAD_ENCLOSING_R,      //destination[register]            source0[memory-offset]         source1[size and depth] size - 32 big bits, depth - 32 little bits (packed: 8/24)       we load variable from n frame  from top
 
-        OP_ALLOCATE_MEMORY,
-        OP_FREE_MEMORY,
+        OP_ALLOCATE_MEMORY,     //destination[register, heap address]  source0[register, size in bytes]
+        OP_FREE_MEMORY,         //destination[register, heap address]
+        OP_MOV_RC,              //destination[register]            source0[constant pool index]     Only in packed code (VMProgram): encoder replaces big immediates and doubles with it
+        // Frame-free access to a slot at fixed depth from stack start (slot ends at stack_start - depth), local access cost.
+        // verify_program replaces *_ENCLOSING_* with them when frame depths are known
+        OP_LOAD_STACK,          //destination[register]            source0[depth]                 source1[size in bytes]
+        OP_STORE_STACK,         //destination[depth]               source0[register]              source1[size in bytes]
 
         // Control flow [91-120]  destination = where
         OP_JMP = 91,
         OP_JMP_CV,      //CV- Condition Valid - destination[where], source0[condition register]
         OP_JMP_CNV,     //CNV - Condition Not Valid - destination[where], source0[condition register]
-        OP_CALL,
-        OP_RET,
+        OP_CALL,        //destination[where], source0[size of callee's frame in bytes], source1[set by verify_program: stack bytes used by the callee]. Callee's frame starts at sp, caller's fp is kept in CallFrame::base_ptr
+        OP_RET,         //Destroys callee's frame (sp = fp) and restores caller's fp
         OP_HALT,
+        // Fused compare and jump: destination[where], source0[first register], source1[second register]. Dont change flags
+        OP_JMP_IEQ,     //Integer ==
+        OP_JMP_INE,     //Integer !=
+        OP_JMP_IGT,     //Integer >
+        OP_JMP_ILT,     //Integer <
+        OP_JMP_IGE,     //Integer >=
+        OP_JMP_ILE,     //Integer <=
+        OP_JMP_DEQ,     //Double ==, NaN -> NAN_FLOAT_VALUE error as in OP_DCMP_RR
+        OP_JMP_DNE,
+        OP_JMP_DGT,
+        OP_JMP_DLT,
+        OP_JMP_DGE,
+        OP_JMP_DLE,
+        OP_CALL_HOST,   //destination[index in VMState::hosts], source0[first argument register, gets result], source1[count of arguments]
         // ... 120
 
         // System Calls [121]
@@ -99,6 +118,22 @@ namespace MalachiteCore
         OP_TC_UITI_R,    //Type Convertion Unsigned Integer To Integer
         OP_TC_DTUI_R,    //Type Convertion Double To Unsigned Integer
         OP_TC_ITUI_R,    //Type Convertion Integer To Unsigned Integer
+
+        // Width-specialized memory [128-191]: same operands as the generic command, size is fixed by the suffix (U8 - 1 byte ... U64 - 8 bytes).
+        // Variant = generic variant start + log2(size), see GetWidthOpCode
+        OP_LOAD_RM_U8 = 128, OP_LOAD_RM_U16, OP_LOAD_RM_U32, OP_LOAD_RM_U64,
+        OP_STORE_MR_U8, OP_STORE_MR_U16, OP_STORE_MR_U32, OP_STORE_MR_U64,
+        OP_PUSH_U8, OP_PUSH_U16, OP_PUSH_U32, OP_PUSH_U64,
+        OP_POP_U8, OP_POP_U16, OP_POP_U32, OP_POP_U64,
+        OP_LOAD_LOCAL_U8, OP_LOAD_LOCAL_U16, OP_LOAD_LOCAL_U32, OP_LOAD_LOCAL_U64,
+        OP_STORE_LOCAL_U8, OP_STORE_LOCAL_U16, OP_STORE_LOCAL_U32, OP_STORE_LOCAL_U64,
+        OP_STORE_ENCLOSING_A_U8, OP_STORE_ENCLOSING_A_U16, OP_STORE_ENCLOSING_A_U32, OP_STORE_ENCLOSING_A_U64,
+        OP_LOAD_ENCLOSING_A_U8, OP_LOAD_ENCLOSING_A_U16, OP_LOAD_ENCLOSING_A_U32, OP_LOAD_ENCLOSING_A_U64,
+        OP_STORE_ENCLOSING_R_U8, OP_STORE_ENCLOSING_R_U16, OP_STORE_ENCLOSING_R_U32, OP_STORE_ENCLOSING_R_U64,
+        OP_LOAD_ENCLOSING_R_U8, OP_LOAD_ENCLOSING_R_U16, OP_LOAD_ENCLOSING_R_U32, OP_LOAD_ENCLOSING_R_U64,
+        OP_LOAD_STACK_U8, OP_LOAD_STACK_U16, OP_LOAD_STACK_U32, OP_LOAD_STACK_U64,
+        OP_STORE_STACK_U8, OP_STORE_STACK_U16, OP_STORE_STACK_U32, OP_STORE_STACK_U64,
+        // ... 191
     };
 
     enum SysCall 
@@ -109,6 +144,7 @@ namespace MalachiteCore
         PRINT_DOUBLE,        // source0[param0-register],
         PRINT_CHAR,         // source0[param0-register]
         PRINT_CHAR_ARRAY,   // source0[param0-pointer], source1[param1-size of string]
+        FLUSH,              // Printed text is written at once (VMState::output)
     };
 
 
@@ -119,11 +155,15 @@ namespace MalachiteCore
         constexpr uint16_t LOGIC_START = 31;
         constexpr uint16_t LOGIC_END = 60;
         constexpr uint16_t MEMORY_START = 61;
-        constexpr uint16_t MEMORY_END = 80;
+        constexpr uint16_t MEMORY_END = 90;
         constexpr uint16_t CONTROL_FLOW_START = 91;
         constexpr uint16_t CONTROL_FLOW_END = 120;
         constexpr uint16_t SYSTEM_CALLS_START = 121;
         constexpr uint16_t SYSTEM_CALLS_END = 121;
+        constexpr uint16_t WIDTH_MEMORY_START = 128;
+        constexpr uint16_t WIDTH_MEMORY_END = 191;
+
+        constexpr uint16_t OPCODE_TABLE_SIZE = 256;   //Size of dispatch tables, every OpCode must be less
 
         inline bool IsOperationInInterval(OpCode value, uint16_t min, uint16_t max) 
         {
@@ -131,4 +171,132 @@ namespace MalachiteCore
         }
     }
 
+    //Width-specialized variant of a generic memory command. Returns generic command if size isnt 1, 2, 4 or 8 or command hasnt variants
+    inline OpCode GetWidthOpCode(OpCode generic, uint64_t size)
+    {
+        uint16_t width_index = 0;
+        switch (size)
+        {
+        case 1: width_index = 0; break;
+        case 2: width_index = 1; break;
+        case 4: width_index = 2; break;
+        case 8: width_index = 3; break;
+        default: return generic;
+        }
+        switch (generic)
+        {
+        case OP_LOAD_RM: return static_cast<OpCode>(OP_LOAD_RM_U8 + width_index);
+        case OP_STORE_MR: return static_cast<OpCode>(OP_STORE_MR_U8 + width_index);
+        case OP_PUSH: return static_cast<OpCode>(OP_PUSH_U8 + width_index);
+        case OP_POP: return static_cast<OpCode>(OP_POP_U8 + width_index);
+        case OP_LOAD_LOCAL: return static_cast<OpCode>(OP_LOAD_LOCAL_U8 + width_index);
+        case OP_STORE_LOCAL: return static_cast<OpCode>(OP_STORE_LOCAL_U8 + width_index);
+        case OP_STORE_ENCLOSING_A: return static_cast<OpCode>(OP_STORE_ENCLOSING_A_U8 + width_index);
+        case OP_LOAD_ENCLOSING_A: return static_cast<OpCode>(OP_LOAD_ENCLOSING_A_U8 + width_index);
+        case OP_STORE_ENCLOSING_R: return static_cast<OpCode>(OP_STORE_ENCLOSING_R_U8 + width_index);
+        case OP_LOAD_ENCLOSING_R: return static_cast<OpCode>(OP_LOAD_ENCLOSING_R_U8 + width_index);
+        case OP_LOAD_STACK: return static_cast<OpCode>(OP_LOAD_STACK_U8 + width_index);
+        case OP_STORE_STACK: return static_cast<OpCode>(OP_STORE_STACK_U8 + width_index);
+        default: return generic;
+        }
+    }
+
+    //Generic command of a width-specialized one, other commands are returned as is
+    inline OpCode GetGenericOpCode(OpCode code)
+    {
+        if (code < OP_LOAD_RM_U8 || code > OP_STORE_STACK_U64) return code;
+        static constexpr OpCode generics[] = { OP_LOAD_RM, OP_STORE_MR, OP_PUSH, OP_POP, OP_LOAD_LOCAL, OP_STORE_LOCAL,
+            OP_STORE_ENCLOSING_A, OP_LOAD_ENCLOSING_A, OP_STORE_ENCLOSING_R, OP_LOAD_ENCLOSING_R, OP_LOAD_STACK, OP_STORE_STACK };
+        return generics[(code - OP_LOAD_RM_U8) / 4];
+    }
+
+    //Size in bytes of a width-specialized command, 0 for another commands
+    inline uint64_t GetOpCodeWidth(OpCode code)
+    {
+        if (code < OP_LOAD_RM_U8 || code > OP_STORE_STACK_U64) return 0;
+        return 1ull << ((code - OP_LOAD_RM_U8) % 4);
+    }
+
+    inline bool IsEnclosingOpCode(OpCode code)
+    {
+        OpCode generic = GetGenericOpCode(code);
+        return generic >= OP_STORE_ENCLOSING_A && generic <= OP_LOAD_ENCLOSING_R;
+    }
+
+    //What command's operands are. Used by passes over byte code (optimizer, verifier)
+    enum OperandRole : uint8_t
+    {
+        ROLE_NONE = 0,          //Isnt used
+        ROLE_READ,              //Register, read
+        ROLE_WRITE,             //Register, written
+        ROLE_READ_WRITE,        //Register, read and written
+        ROLE_TARGET,            //Instruction pointer
+        ROLE_VALUE,             //Offset, size, address, flag, count, syscall id or constant index
+    };
+
+    struct OperandRoles
+    {
+        OperandRole destination = ROLE_NONE;
+        OperandRole source0 = ROLE_NONE;
+        OperandRole source1 = ROLE_NONE;
+    };
+
+    inline OperandRoles GetOperandRoles(OpCode code)
+    {
+        switch (GetGenericOpCode(code))
+        {
+        case OP_IADD_RRR: case OP_ISUB_RRR: case OP_IMUL_RRR: case OP_IDIV_RRR: case OP_IMOD_RRR:
+        case OP_UADD_RRR: case OP_USUB_RRR: case OP_UMUL_RRR: case OP_UDIV_RRR: case OP_UMOD_RRR:
+        case OP_DADD_RRR: case OP_DSUB_RRR: case OP_DMUL_RRR: case OP_DDIV_RRR:
+        case OP_AND_RRR: case OP_OR_RRR: case OP_BIT_OR_RRR: case OP_BIT_AND_RRR:
+        case OP_BIT_OFFSET_LEFT_RRR: case OP_BIT_OFFSET_RIGHT_RRR:
+            return { ROLE_WRITE, ROLE_READ, ROLE_READ };
+        case OP_INEG_RR: case OP_DNEG_RR: case OP_NOT_RR: case OP_BIT_NOT_RR: case OP_MOV_RR:
+            return { ROLE_WRITE, ROLE_READ, ROLE_NONE };
+        case OP_CMP_RR: case OP_DCMP_RR:
+            return { ROLE_NONE, ROLE_READ, ROLE_READ };
+        case OP_GET_FLAG: case OP_MOV_RC:
+            return { ROLE_WRITE, ROLE_VALUE, ROLE_NONE };
+        case OP_MOV_RI_INT: case OP_MOV_RI_UINT: case OP_MOV_RI_DOUBLE:
+            return { ROLE_WRITE, ROLE_NONE, ROLE_NONE };
+        case OP_LOAD_RM: case OP_LOAD_LOCAL: case OP_LOAD_ENCLOSING_A: case OP_LOAD_ENCLOSING_R: case OP_LOAD_STACK:
+            return { ROLE_WRITE, ROLE_VALUE, ROLE_VALUE };
+        case OP_STORE_MR: case OP_STORE_LOCAL: case OP_STORE_ENCLOSING_A: case OP_STORE_ENCLOSING_R: case OP_STORE_STACK:
+            return { ROLE_VALUE, ROLE_READ, ROLE_VALUE };
+        case OP_PUSH:
+            return { ROLE_VALUE, ROLE_READ, ROLE_NONE };
+        case OP_POP:
+            return { ROLE_WRITE, ROLE_VALUE, ROLE_NONE };
+        case OP_CREATE_FRAME: case OP_DESTROY_FRAMES:
+            return { ROLE_VALUE, ROLE_NONE, ROLE_NONE };
+        case OP_ALLOCATE_MEMORY:
+            return { ROLE_WRITE, ROLE_READ, ROLE_NONE };
+        case OP_FREE_MEMORY:
+            return { ROLE_READ, ROLE_NONE, ROLE_NONE };
+        case OP_JMP:
+            return { ROLE_TARGET, ROLE_NONE, ROLE_NONE };
+        case OP_CALL:
+            return { ROLE_TARGET, ROLE_VALUE, ROLE_NONE };
+        case OP_JMP_CV: case OP_JMP_CNV:
+            return { ROLE_TARGET, ROLE_READ, ROLE_NONE };
+        case OP_JMP_IEQ: case OP_JMP_INE: case OP_JMP_IGT: case OP_JMP_ILT: case OP_JMP_IGE: case OP_JMP_ILE:
+        case OP_JMP_DEQ: case OP_JMP_DNE: case OP_JMP_DGT: case OP_JMP_DLT: case OP_JMP_DGE: case OP_JMP_DLE:
+            return { ROLE_TARGET, ROLE_READ, ROLE_READ };
+        case OP_CALL_HOST:
+            return { ROLE_VALUE, ROLE_READ_WRITE, ROLE_VALUE };   //Registers after source0 are read too
+        case OP_SYSTEM_CALL:
+            return { ROLE_VALUE, ROLE_READ, ROLE_READ };  //Parameters depend on the call, both are counted as read
+        case OP_TC_ITD_R: case OP_TC_DTI_R: case OP_TC_UITD_R: case OP_TC_UITI_R: case OP_TC_DTUI_R: case OP_TC_ITUI_R:
+            return { ROLE_READ_WRITE, ROLE_NONE, ROLE_NONE };
+        default:
+            return {};
+        }
+    }
+
+    //Execution doesnt continue with the next command
+    inline bool IsTerminatorOpCode(OpCode code)
+    {
+        return code == OP_JMP || code == OP_RET || code == OP_HALT;
+    }
+
 }
\ No newline at end of file
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace MalachiteCore
+{
+    constexpr size_t OUTPUT_BUFFER_SIZE = 8192;     //Bytes collected before one write to the descriptor
+    constexpr int OUTPUT_STDOUT = 1;
+
+    // Output of print system calls. Text is collected in the buffer and written by one write call when it is full,
+    // when execution ends (end of code, HALT, error) or by FLUSH system call. Destructor writes the rest
+    class OutputBuffer
+    {
+    private:
+        char m_data[OUTPUT_BUFFER_SIZE];
+        size_t m_size = 0;
+        int m_descriptor = OUTPUT_STDOUT;
+
+        char* reserve(size_t size) {    //Place for size bytes, size <= OUTPUT_BUFFER_SIZE
+            if (m_size + size > OUTPUT_BUFFER_SIZE) flush();
+            return m_data + m_size;
+        }
+    public:
+        explicit OutputBuffer(int descriptor = OUTPUT_STDOUT) : m_descriptor(descriptor) {}
+        OutputBuffer(const OutputBuffer&) = delete;
+        OutputBuffer& operator=(const OutputBuffer&) = delete;
+        ~OutputBuffer() { flush(); }
+
+        void write_int(int64_t value);
+        void write_uint(uint64_t value);
+        void write_double(double value);    //Same text as std::ostream with default format (%g, 6 digits)
+        void write(const char* data, size_t size);
+        void write_char(char value) {
+            *reserve(1) = value;
+            m_size++;
+        }
+
+        void flush();       //Buffered text goes to the descriptor, stdio buffer of stdout is flushed before to keep the order
+        void clear() { m_size = 0; }    //Buffered text is dropped
+
+        size_t size() const { return m_size; }
+        int descriptor() const { return m_descriptor; }
+        void set_descriptor(int descriptor) {
+            flush();
+            m_descriptor = descriptor;
+        }
+    };
+}
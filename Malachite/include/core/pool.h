@@ -0,0 +1,26 @@
+#pragma once
+#include "vm.h"
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace MalachiteCore
+{
+    // Thread-safe cache of VMState with the same MemoryConfig. Released states are reset (only written memory is zeroed)
+    class VMStatePool
+    {
+    public:
+        explicit VMStatePool(const MemoryConfig& config = MemoryConfig(), size_t max_size = 64);
+
+        std::unique_ptr<VMState> acquire();                 //Reset state from pool or new one
+        void release(std::unique_ptr<VMState> state);       //Full pool and states with another layout are destroyed
+
+        size_t size() const;
+        const MemoryConfig& config() const { return m_config; }
+    private:
+        const MemoryConfig m_config;
+        const size_t m_max_size;
+        mutable std::mutex m_mutex{};
+        std::vector<std::unique_ptr<VMState>> m_states{};
+    };
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "vm.h"
+#include <algorithm>
+#include <vector>
+
+namespace MalachiteCore
+{
+    // Runtime form of VMCommand. Registers, offsets, sizes and jump targets fit into 32 bits,
+    // 64-bit immediates and doubles are moved to the constant pool of VMProgram.
+    struct PackedCommand
+    {
+        OpCode operation = OpCode::OP_NOP;
+        uint16_t reserved = 0;
+        uint32_t destination = 0;
+        uint32_t source0 = 0;
+        uint32_t source1 = 0;
+    };
+    static_assert(sizeof(PackedCommand) == 16, "PackedCommand must be 16 bytes");
+
+    // *_ENCLOSING_* commands: source1 keeps size in 8 big bits and depth in 24 little bits
+    constexpr uint32_t PACKED_SIZE_SHIFT = 24;
+    constexpr uint32_t PACKED_DEPTH_MASK = (1u << PACKED_SIZE_SHIFT) - 1;
+
+    // Result of verify_program. Runtime checks that are proved by it are skipped by execute
+    struct ProgramVerification
+    {
+        bool verified = false;
+        uint64_t memory_size = 0;   //Smallest VMState::memory_size for absolute addresses of OP_LOAD_RM/OP_STORE_MR
+        uint64_t stack_size = 0;    //Smallest stack section for the deepest push and frame access
+        uint64_t failed_ip = 0;     //First command that didnt pass (if not verified)
+        uint64_t resolved_accesses = 0;     //*_ENCLOSING_* commands replaced with *_STACK ones
+        uint64_t host_functions = 0;        //Smallest size of VMState::hosts for indices of OP_CALL_HOST
+    };
+
+    // Source lines of commands, run-length encoded: run covers ips from its ip to ip of the next run.
+    // Side table of debug information, execute doesnt read it. Line 0 - unknown (code generated by compiler)
+    struct LineTable
+    {
+        struct Run
+        {
+            uint64_t ip;
+            uint32_t line;
+        };
+        std::vector<Run> runs{};
+        uint64_t commands = 0;      //Covered ips [0, commands)
+
+        void append(uint32_t line) {    //Line of the next command
+            if (runs.empty() || runs.back().line != line) runs.push_back({ commands, line });
+            commands++;
+        }
+        uint32_t line(uint64_t ip) const {
+            if (ip >= commands) return 0;
+            auto run = std::upper_bound(runs.begin(), runs.end(), ip, [](uint64_t value, const Run& run) { return value < run.ip; });
+            return run == runs.begin() ? 0 : (run - 1)->line;
+        }
+        bool empty() const { return commands == 0; }
+    };
+
+    struct VMProgram
+    {
+        std::vector<PackedCommand> code;
+        std::vector<Register> constants;    //Constant pool, OP_MOV_RC loads from it by index
+        ProgramVerification verification;
+        LineTable lines;                    //Empty if program isnt compiled from source
+    };
+
+    // Packs wide commands 1:1 (ip of a packed command == ip of the wide one).
+    // Returns VMCS_INVALID if some operand doesnt fit into its packed field
+    VMError encode_program(const VMCommand* commands, size_t commands_size, VMProgram& program);
+}
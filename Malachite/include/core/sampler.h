@@ -0,0 +1,75 @@
+#pragma once
+#include "program.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iosfwd>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace MalachiteCore
+{
+    constexpr uint32_t SAMPLE_SKIP_WINDOW = 1024;   //Switch loop: sample is taken 1..SAMPLE_SKIP_WINDOW commands after the request is seen
+
+    // Samples of one running VMState, attached by VMState::samples (isnt owned). execute uses the sample loop if it is set.
+    // The loop takes samples itself (ip and call stack), the sampler thread never reads the running state:
+    // - computed goto loop dispatches by dispatch table of VMSamples, arm sets all entries to the sample label of the running loop,
+    //   so the next command is sampled and the table is restored. Loop has no additional checks
+    // - switch loop polls request on backward jumps and calls and takes the sample a random count of commands later
+    // Time of a long host function or system call goes to the command after it. Values are summed over runs until clear
+    struct VMSamples
+    {
+        std::atomic<bool> request{ false };     //Set by arm, cleared by the switch loop (and on start of a run: time between runs isnt sampled)
+        std::atomic<const void*> dispatch[OperationListBlock::OPCODE_TABLE_SIZE]{};    //Table of the running computed goto loop
+        std::map<std::vector<uint64_t>, uint64_t> stacks{};    //Ips of call commands from the outermost one, then sampled ip -> count
+        uint64_t total = 0;
+        uint64_t random = 0x9E3779B97F4A7C15ull;     //xorshift state of next_skip
+
+        //Called by VMSampler from its thread
+        void arm();
+        //Called by the loop
+        void enter(const void* const* table, const void* sample_target);    //Table is copied, arm redirects it to sample_target
+        void leave();
+        void disarm(const void* const* table);
+        void take(const VMState* state, uint64_t ip);
+        uint32_t next_skip();                           //1..SAMPLE_SKIP_WINDOW
+
+        void clear();
+    private:
+        std::mutex mutex{};                     //arm doesnt write the table of a loop that has left
+        const void* sample_target = nullptr;    //nullptr - computed goto loop isnt running
+    };
+
+    // Watchdog thread: every period it arms attached samples. Runs only between start and stop
+    class VMSampler
+    {
+    public:
+        VMSampler() = default;
+        VMSampler(const VMSampler&) = delete;
+        VMSampler& operator=(const VMSampler&) = delete;
+        ~VMSampler() { stop(); }
+
+        void attach(VMSamples* samples);
+        void detach(VMSamples* samples);
+
+        void start(std::chrono::microseconds period = std::chrono::microseconds(1000));
+        void stop();
+        bool running() const { return thread.joinable(); }
+    private:
+        std::mutex mutex{};
+        std::condition_variable stop_condition{};
+        std::vector<VMSamples*> attached{};
+        std::chrono::microseconds period{};
+        bool stopping = false;
+        std::thread thread{};
+
+        void run();
+    };
+
+    // Reports by source lines of program->lines (ips if the program has no lines, "?" for line 0).
+    // Flat: samples by line of sampled ip, the hottest first. Folded: "frame;frame;frame count" per stack, input of flamegraph.pl and speedscope
+    void dump_samples_flat(const VMSamples& samples, const VMProgram& program, std::ostream& out, size_t top_lines = 20);
+    void dump_samples_folded(const VMSamples& samples, const VMProgram& program, std::ostream& out);
+}
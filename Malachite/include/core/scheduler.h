@@ -0,0 +1,95 @@
+#pragma once
+#include "functions.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace MalachiteCore
+{
+    using InstanceID = uint64_t;
+
+    enum class InstanceStatus : uint8_t
+    {
+        ACTIVE = 0,     //In a run queue or running
+        FINISHED,       //End of code or OP_HALT (error = EXIT)
+        FAILED,         //error and ip are set
+        CANCELLED,      //stop() was called
+    };
+
+    struct InstanceResult
+    {
+        InstanceStatus status = InstanceStatus::ACTIVE;
+        VMError error = VMError::NO_ERROR;
+        uint64_t ip = 0;
+    };
+
+    // Runs many VMState instances on a pool of threads. Programs are shared read-only, every instance is executed
+    // by execute_slice (budget per slice), yielded instance is returned to the queue of its worker.
+    // Each worker has own deque: owner takes from front, idle workers steal from back of another deques.
+    class VMScheduler
+    {
+    public:
+        using CompletionCallback = std::function<void(InstanceID, const InstanceResult&)>;   //Called from worker thread
+
+        explicit VMScheduler(size_t workers_count = 0, uint64_t slice_budget = 100000);    //workers 0 -> hardware_concurrency, slice_budget 0 -> 1 (slice has to end, 0 is unlimited for execute_slice)
+        VMScheduler(const VMScheduler&) = delete;
+        VMScheduler& operator=(const VMScheduler&) = delete;
+        ~VMScheduler();     //Cancels unfinished instances and joins workers
+
+        void set_completion_callback(CompletionCallback callback);
+
+        InstanceID submit(std::shared_ptr<const VMProgram> program, std::unique_ptr<VMState> state = nullptr);
+        void stop(InstanceID id);
+
+        InstanceResult result(InstanceID id) const;
+        InstanceResult wait(InstanceID id);
+        void wait_all();
+        std::unique_ptr<VMState> take_state(InstanceID id);    //Only for finished instances, removes the instance
+
+        size_t workers_count() const { return workers.size(); }
+    private:
+        struct Instance
+        {
+            InstanceID id = 0;
+            std::shared_ptr<const VMProgram> program{};
+            std::unique_ptr<VMState> state{};
+            std::atomic<bool> stop_request{ false };
+            InstanceResult result{};
+        };
+        struct Worker
+        {
+            std::mutex mutex{};
+            std::deque<std::shared_ptr<Instance>> queue{};
+            std::thread thread{};
+        };
+
+        std::vector<std::unique_ptr<Worker>> workers{};
+        const uint64_t slice_budget;
+
+        mutable std::mutex instances_mutex{};
+        std::condition_variable finished_condition{};
+        std::unordered_map<InstanceID, std::shared_ptr<Instance>> instances{};
+        InstanceID next_id = 1;
+        size_t unfinished = 0;
+        CompletionCallback completion_callback{};
+
+        std::mutex idle_mutex{};
+        std::condition_variable work_condition{};
+        std::atomic<size_t> queued{ 0 };    //Instances in all queues, counted before their push: never less than them
+        std::atomic<size_t> sleeping{ 0 };  //Workers waiting for work_condition, only they are notified
+        std::atomic<bool> shutting_down{ false };
+        std::atomic<size_t> next_worker{ 0 };
+
+        void push(size_t worker, std::shared_ptr<Instance> instance);
+        void requeue(size_t worker, std::shared_ptr<Instance> instance);   //Yielded instance, idle_mutex is taken only to wake a sleeping worker
+        void wake_one();
+        std::shared_ptr<Instance> take(size_t worker);
+        void run_worker(size_t worker);
+        bool run_slice(Instance& instance, InstanceResult& result);     //true -> instance is complete, result is filled
+        void complete(Instance& instance, const InstanceResult& result);
+    };
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include "vm.h"
+#include <memory>
+
+namespace MalachiteCore
+{
+    // Image of a stopped VMState (after an initialization prologue, for example). Forks continue from the same ip
+    // with the same registers, stacks and memory; memory pages are shared copy-on-write between the image and all forks
+    class VMSnapshot
+    {
+    public:
+        explicit VMSnapshot(const VMState& state);
+
+        std::unique_ptr<VMState> fork() const;     //Thread-safe, snapshot has to outlive nothing: forks own their mappings
+
+        const MemoryConfig& config() const { return m_config; }
+        bool shared_pages() const { return m_memory.shared_pages(); }
+    private:
+        MemoryConfig m_config;
+        MemoryImage m_memory;
+        HeapMemoryAllocator m_heap;
+
+        Register m_registers[REGISTER_COUNT];
+        uint64_t m_ip, m_sp, m_hp, m_fp;
+        uint32_t m_flags;
+        uint64_t m_heap_high_water, m_stack_low_water;
+        std::unique_ptr<CallStack> m_call_stack;
+        std::unique_ptr<DataStack> m_data_stack;
+        std::unique_ptr<DataStack> m_temp_data_stack;
+        std::unique_ptr<ErrorStack> m_error_stack;
+    };
+}
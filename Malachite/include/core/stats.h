@@ -0,0 +1,66 @@
+#pragma once
+#include "operations.h"
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace MalachiteCore
+{
+    // Groups of operations by OperationListBlock ranges, width-specialized commands are MEMORY
+    enum class OperationClass : uint8_t
+    {
+        OTHER = 0,          //OP_NOP and operations out of blocks
+        ARITHMETIC,
+        LOGIC,
+        MEMORY,
+        CONTROL_FLOW,
+        SYSTEM_CALLS,
+        TYPES_CONVERTION,
+        COUNT,
+    };
+    constexpr size_t OPERATION_CLASS_COUNT = static_cast<size_t>(OperationClass::COUNT);
+
+    inline OperationClass get_operation_class(OpCode code)
+    {
+        using namespace OperationListBlock;
+        if (IsOperationInInterval(code, ARITHMETIC_START, ARITHMETIC_END)) return OperationClass::ARITHMETIC;
+        if (IsOperationInInterval(code, LOGIC_START, LOGIC_END)) return OperationClass::LOGIC;
+        if (IsOperationInInterval(code, MEMORY_START, MEMORY_END) || IsOperationInInterval(code, WIDTH_MEMORY_START, WIDTH_MEMORY_END)) return OperationClass::MEMORY;
+        if (IsOperationInInterval(code, CONTROL_FLOW_START, CONTROL_FLOW_END)) return OperationClass::CONTROL_FLOW;
+        if (IsOperationInInterval(code, SYSTEM_CALLS_START, SYSTEM_CALLS_END)) return OperationClass::SYSTEM_CALLS;
+        if (code > SYSTEM_CALLS_END && code < WIDTH_MEMORY_START) return OperationClass::TYPES_CONVERTION;
+        return OperationClass::OTHER;
+    }
+    const char* get_operation_class_name(OperationClass operation_class);
+
+    struct VMProfile
+    {
+        uint64_t commands[OperationListBlock::OPCODE_TABLE_SIZE] = {};  //Executed commands by operation
+
+        uint64_t total() const
+        {
+            uint64_t sum = 0;
+            for (uint64_t count : commands) sum += count;
+            return sum;
+        }
+    };
+
+    // Counters of the profile policy, attached by VMState::stats (isnt owned). Values are summed over runs until clear.
+    // Native code of JIT isnt counted, only commands executed by interpreter
+    struct VMStats
+    {
+        VMProfile profile{};                    //By operation (if ExecutionOptions::profile isnt set, otherwise it gets them)
+        std::vector<uint64_t> ips{};            //By ip of packed program, grows to the program on run
+        uint32_t timing_period = 0;             //Every N-th command is timed, 0 - timing is off
+        uint64_t class_time[OPERATION_CLASS_COUNT] = {};    //Ticks of timed commands: rdtsc on x86-64, steady_clock nanoseconds on another targets
+        uint64_t class_timed[OPERATION_CLASS_COUNT] = {};   //Count of timed commands
+        uint64_t runs = 0;
+        uint64_t run_time = 0;                  //Nanoseconds in execute
+
+        void clear();
+    };
+
+    using OpCodeNameFunction = std::string(*)(const OpCode& code);
+    // Text report: run time, operations by count, classes with average ticks, the hottest ips. name gives names of operations (numbers if nullptr)
+    void dump_stats(const VMStats& stats, std::ostream& out, size_t top_ips = 10, OpCodeNameFunction name = nullptr);
+}
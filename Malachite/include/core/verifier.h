@@ -0,0 +1,17 @@
+#pragma once
+#include "program.h"
+
+namespace MalachiteCore
+{
+    // Static checks of a finished program: opcodes, register indices, jump targets, access sizes and frame layout.
+    // Every command has to be reached with one frame layout (frame depths, stack depth and function of the body), so frame-relative
+    // offsets, pushes and pops are checked against known values; stack and memory sizes they need are written to verification.
+    // Function body is checked once for all calls, from the callee's frame (a level without data stack frame) made by OP_CALL:
+    // depths are relative to sp of the call, OP_RET returns to any caller and frames of the callee are destroyed before it.
+    // So recursion and calls from different places pass; bodies that reach caller's frames (OP_*_ENCLOSING_A) dont.
+    // Call depth and stack of a call stay checked at run: OP_CALL source1 is set to stack bytes the callee uses.
+    // program has to be encoded from the same commands (encode_program), result is written to program.verification.
+    // In a verified program enclosing accesses outside of functions are replaced with OP_LOAD_STACK/OP_STORE_STACK: depth of their frames is known,
+    // so outer variables cost as locals. Frame depths are counted from an empty stack, as execute starts a fresh state
+    VMError verify_program(const VMCommand* commands, size_t commands_size, VMProgram& program);
+}
@@ -2,15 +2,13 @@
 #include "operations.h"
 #include "errors.h"
 #include "vmstructs.h"
+#include "memory.h"
+#include "output.h"
 
 namespace MalachiteCore {
    
-    // Section boundaries
+    // Section boundaries: heap starts at 0, another ones are in VMState (depend on MemoryConfig)
     constexpr size_t HEAP_START = 0;
-    constexpr size_t HEAP_END = HEAP_START + HEAP_SIZE - 1;
-
-    constexpr size_t STACK_START = MAX_MEMORY_SIZE - 1;  // Top of memory
-    constexpr size_t STACK_END = STACK_START - STACK_SIZE + 1;
 
 
 
@@ -28,6 +26,10 @@ namespace MalachiteCore {
 
     using ErrorStack = Stack<ErrorFrame, ERROR_STACK_SIZE>;
 
+    class HostRegistry;
+    struct VMStats;
+    struct VMSamples;
+
     struct TypesTable 
     {
     
@@ -73,11 +75,50 @@ namespace MalachiteCore {
         uint32_t flags;  //Special flags
 
 
-        uint8_t memory[MAX_MEMORY_SIZE];    
+        uint8_t* memory;            // = memory_block.data()
+        uint64_t memory_size;       // heap + stack
+        uint64_t heap_end;          // Last heap byte
+        uint64_t stack_start;       // Top of memory
+        uint64_t stack_end;         // Last stack byte (stack grows to it)
+        uint64_t heap_high_water;   // Heap bytes [0, heap_high_water) can be written
+        uint64_t stack_low_water;   // Stack bytes [stack_low_water, memory_size) can be written
+        VMMemory memory_block;      // Owner of memory, zeroed pages are mapped on first access
+        HeapMemoryAllocator heap;   // Blocks of heap section (OP_ALLOCATE_MEMORY), hp = heap.top()
 
         
-        VMState() : ip(0),sp(MAX_MEMORY_SIZE - 1), hp(0), fp(MAX_MEMORY_SIZE - 1) {
-            memset(memory, 0, MAX_MEMORY_SIZE);
+        explicit VMState(const MemoryConfig& config = MemoryConfig()) : VMState(config, VMMemory(config.memory_size(), config.huge_pages)) {}
+        // Memory is prepared by caller (VMSnapshot::fork), its size is config.memory_size()
+        VMState(const MemoryConfig& config, VMMemory&& block) : ip(0), hp(0), flags(0), memory_block(std::move(block)), heap(config.heap_size) {
+            memory = memory_block.data();
+            memory_size = config.memory_size();
+            heap_end = HEAP_START + config.heap_size - 1;
+            stack_start = memory_size - 1;
+            stack_end = stack_start - config.stack_size + 1;
+            sp = stack_start;
+            fp = stack_start;
+            heap_high_water = HEAP_START;
+            stack_low_water = memory_size;
+            hp = heap.top();
+        }
+        // Returns the state to the constructed one, only written memory ranges are zeroed
+        void reset() {
+            for (auto& reg : registers) reg.u = 0;
+            ip = 0;
+            sp = stack_start;
+            fp = stack_start;
+            flags = 0;
+            uint64_t heap_dirty = hp > heap_high_water ? hp : heap_high_water;
+            heap.reset();
+            hp = heap.top();
+            memory_block.zero(HEAP_START, heap_dirty < memory_size ? heap_dirty : memory_size);
+            if (stack_low_water < memory_size) memory_block.zero(stack_low_water, memory_size - stack_low_water);
+            heap_high_water = HEAP_START;
+            stack_low_water = memory_size;
+            call_stack.clear();
+            data_stack.clear();
+            temp_data_stack.clear();
+            error_stack.clear();
+            output.flush();
         }
         // Стек вызовов
         CallStack call_stack;
@@ -85,13 +126,17 @@ namespace MalachiteCore {
         DataStack temp_data_stack;  //<- DS for up/down frame transition 
         TypesTable types_table; //Таблица типов: классы и структуры
         ErrorStack error_stack;
+        OutputBuffer output;        //Print system calls, flushed when execution ends
+        const HostRegistry* hosts = nullptr;   //Functions of OP_CALL_HOST, isnt owned
+        VMStats* stats = nullptr;              //Profile counters, execute uses the profile loop if it is set. Isnt owned
+        VMSamples* samples = nullptr;          //Sampling profiler, execute uses the sample loop if it is set. Isnt owned
     };
 
-    inline bool is_valid_heap_address(uint64_t addr) {
-        return addr >= HEAP_START && addr <= HEAP_END;
+    inline bool is_valid_heap_address(const VMState* state, uint64_t addr) {
+        return addr >= HEAP_START && addr <= state->heap_end;
     }
 
-    inline bool is_valid_stack_address(uint64_t addr) {
-        return addr >= STACK_END && addr <= STACK_START;
+    inline bool is_valid_stack_address(const VMState* state, uint64_t addr) {
+        return addr >= state->stack_end && addr <= state->stack_start;
     }
 }
\ No newline at end of file
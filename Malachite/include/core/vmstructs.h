@@ -1,5 +1,7 @@
 #pragma once
 #include "string"
+#include "errors.h"
+#include <vector>
 
 namespace MalachiteCore 
 {
@@ -9,6 +11,7 @@ namespace MalachiteCore
 
     using Pointer = uint64_t;   //For external using, in vm used uint64_t
 
+    // Default memory layout, every VMState can use own sizes (MemoryConfig)
     constexpr size_t MAX_MEMORY_SIZE = 65536; //64KB
     constexpr size_t STACK_SIZE = MAX_MEMORY_SIZE * 4 / 8;  // 32KB  
     constexpr size_t HEAP_SIZE = MAX_MEMORY_SIZE * 4 / 8;   // 32KB
@@ -71,41 +74,100 @@ namespace MalachiteCore
             return m_data[index];
         }
 
+        // Non-throwing variants for the VM loop: errors are returned as VMError
+        VMError try_push(const T& value) {
+            if (m_top >= MAX_SIZE) return VMError::STACK_OVERFLOW;
+            m_data[m_top++] = value;
+            return VMError::NO_ERROR;
+        }
+
+        VMError try_pop(T& value) {
+            if (m_top == 0) return VMError::STACK_UNDERFLOW;
+            value = m_data[--m_top];
+            return VMError::NO_ERROR;
+        }
+
+        // Unchecked accessors, caller has validated size (full/empty/size) or the program is verified
+        void push_unchecked(const T& value) { m_data[m_top++] = value; }
+        T pop_unchecked() { return m_data[--m_top]; }
+        T& top_unchecked() { return m_data[m_top - 1]; }
+        const T& at_unchecked(size_t index) const { return m_data[index]; }
+        void truncate_unchecked(size_t size) { m_top = size; }    //Drops elements above size
+
         size_t size() const { return m_top; }
         bool empty() const { return m_top == 0; }
+        bool full() const { return m_top >= MAX_SIZE; }
         void clear() { m_top = 0; }
+        void assign(const Stack& other) {   //Copies only used elements
+            for (size_t i = 0; i < other.m_top; i++) m_data[i] = other.m_data[i];
+            m_top = other.m_top;
+        }
 
         //   
         const T* begin() const { return m_data; }
         const T* end() const { return m_data + m_top; }
     };
 
-    struct HeapMemoryAllocator    //
+    constexpr size_t HEAP_GRANULE = 8;          //Allocation unit, blocks are aligned to it
+    constexpr size_t HEAP_SIZE_CLASSES = 32;    //Freed blocks up to HEAP_SIZE_CLASSES granules (256 bytes) are reused in O(1)
+
+    struct HeapStats
     {
-    private:
-        const uint8_t* space;
-        const size_t heap_size;
-        //Low level map
-        uint8_t free_bitmap[HEAP_SIZE/8];  //sectors with alignas = 8 bytes
+        uint64_t heap_size = 0;
+        uint64_t used_bytes = 0;            //Allocated blocks, sizes are rounded up to HEAP_GRANULE
+        uint64_t cached_bytes = 0;          //Freed blocks kept in size-class lists
+        uint64_t free_bytes = 0;            //Free in bitmap (includes never touched heap above top)
+        uint64_t largest_free_block = 0;
+        uint64_t peak_used_bytes = 0;
+        uint64_t top = 0;                   //End of the highest block, heap above it wasnt given out
+        uint64_t allocations = 0;
+        uint64_t frees = 0;
+        uint64_t failed_allocations = 0;
+        uint64_t size_class_hits = 0;       //Allocations served by size-class lists
+
+        //0 - all free memory is one block, near 1 - free memory is split into small holes
+        double fragmentation() const { return free_bytes == 0 ? 0.0 : 1.0 - static_cast<double>(largest_free_block) / free_bytes; }
+    };
 
+    // Heap section allocator. Bitmap has a bit per granule (1 - used) and a second one marks last granules of blocks,
+    // so free() doesnt need size. Both are sized by top: heap above it is free without bitmap words.
+    // Allocator doesnt write VM memory, all its data is outside (VMState copies it with the state)
+    class HeapMemoryAllocator
+    {
     public:
-        HeapMemoryAllocator(uint8_t* memory, size_t size) : space(memory), heap_size(size) {}
+        explicit HeapMemoryAllocator(size_t heap_size);
 
-        uint64_t allocate(size_t size)  //return memory pointer, if memory part with this size isnt defined -> error. pointer + size <= HEAP_END
-        {
-            return 0;
-        }
-        void free(uint64_t pointer, size_t size)
-        {
-            return;
-        }
-        /*
-            __builtin_clzll(x)  // Count Leading Zeros
-            __builtin_ctzll(x)  // Count Trailing Zeros  
-            __builtin_ffsll(x)  // Find First Set (1-based)
-            __builtin_popcountll(x) // Population Count
-        
-        */
+        uint64_t allocate(size_t size);     //Returns heap address or 0 (granule 0 is reserved, so 0 is never a block)
+        bool free(uint64_t pointer);        //false - pointer isnt a start of an allocated block
+        size_t block_size(uint64_t pointer) const;  //0 - pointer isnt a start of an allocated block
+        void reset();
+
+        uint64_t top() const { return m_top * HEAP_GRANULE; }
+        size_t heap_size() const { return m_granules * HEAP_GRANULE; }
+        HeapStats stats() const;
+    private:
+        size_t m_granules;
+        size_t m_top;               //Granules [m_top, m_granules) are free and out of bitmaps
+        size_t m_first_free_word;   //Words before it are full
+        std::vector<uint64_t> m_used;
+        std::vector<uint64_t> m_ends;
+        std::vector<uint64_t> m_cached;     //First granules of blocks in size-class lists (they stay used in m_used)
+        std::vector<uint64_t> m_classes[HEAP_SIZE_CLASSES];    //Block addresses by size in granules - 1
+
+        size_t m_used_granules;
+        size_t m_cached_granules;
+        size_t m_peak_granules;
+        uint64_t m_allocations;
+        uint64_t m_frees;
+        uint64_t m_failed_allocations;
+        uint64_t m_size_class_hits;
+
+        bool is_block_start(size_t granule) const;
+        size_t block_granules(size_t granule) const;
+        size_t find_free(size_t count) const;
+        void take(size_t granule, size_t count);
+        void release(size_t granule, size_t count);
+        void flush_size_classes();
     };
 
 }
\ No newline at end of file
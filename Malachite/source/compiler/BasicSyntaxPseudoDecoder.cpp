@@ -314,6 +314,98 @@ namespace Malachite
 		return result;
 	}
 
+	std::vector<PseudoCommand> BasicSyntaxPseudoDecoder::ParseFunctionBlock(const ASTNode& node, std::shared_ptr<CompilationState> state, recursive_handler rh)
+	{
+		std::vector<PseudoCommand> commands;
+		//func name ( type arg , ... ) -> return_type, without "->" function returns void
+		if (node.tokens.size() < 4) { Logger::Get().PrintSyntaxError("Invalid function. Invalid function header's structure.", node.tokens[0].line); return commands; }
+		if (state->GetSpacesDepth() != 1) { Logger::Get().PrintLogicError("Functions can be declared only in the global scope.", node.tokens[0].line); return commands; }
+
+		Token name = node.tokens[1];
+		if (name.type != TokenType::IDENTIFIER) { Logger::Get().PrintSyntaxError("Invalid function. Invalid or missed function's name \"" + name.value.strVal + "\"", node.tokens[0].line); return commands; }
+		if (node.tokens[2].value.strVal != "(") { Logger::Get().PrintSyntaxError("Invalid function. Missed '(' after function's name.", node.tokens[0].line); return commands; }
+
+		std::vector<std::vector<Token>> args;
+		int depth = 0;
+		size_t args_end = SIZE_MAX;
+		for (size_t i = 2; i < node.tokens.size(); i++)
+		{
+			Token t = node.tokens[i];
+			if (t.type == TokenType::DELIMITER)
+			{
+				if (t.value.strVal == "(")
+				{
+					depth++;
+					if (depth == 1) { args.push_back({}); continue; }
+				}
+				else if (t.value.strVal == ")") { depth--; if (depth == 0) { args_end = i; break; } }
+				if (t.value.strVal == "," && depth == 1) { args.push_back({}); continue; }
+			}
+			if (depth > 0) args.back().push_back(t);
+		}
+		if (args_end == SIZE_MAX) { Logger::Get().PrintSyntaxError("Invalid function. Missed ')' after function's arguments.", node.tokens[0].line); return commands; }
+		if (args.size() == 1 && args[0].empty()) args.clear();	//func name()
+
+		std::string return_type_name = SyntaxInfoKeywords::Get().typemarker_void;
+		if (args_end + 1 < node.tokens.size() && node.tokens[args_end + 1].type != TokenType::COMPILATION_LABEL)
+		{
+			if (node.tokens[args_end + 1].value.strVal != "->" || args_end + 2 >= node.tokens.size()) { Logger::Get().PrintSyntaxError("Invalid function. Returned type is \"-> type\".", node.tokens[0].line); return commands; }
+			return_type_name = node.tokens[args_end + 2].value.strVal;
+		}
+		auto* return_type = state->FindType(return_type_name);
+		if (!return_type) { Logger::Get().PrintTypeError("Type \"" + return_type_name + "\" doesn't exist", node.tokens[0].line); return commands; }
+
+		std::vector<Variable> arguments;
+		for (auto& arg : args)
+		{
+			if (arg.size() != 2 || arg[1].type != TokenType::IDENTIFIER) { Logger::Get().PrintSyntaxError("Invalid function's argument. Argument is \"type name\".", node.tokens[0].line); return commands; }
+			auto* type = state->FindType(arg[0].value.strVal);
+			if (!type) { Logger::Get().PrintTypeError("Type \"" + arg[0].value.strVal + "\" doesn't exist", arg[0].line); return commands; }
+			for (auto& other : arguments)
+			{
+				if (other.name == arg[1].value.strVal) { Logger::Get().PrintLogicError("Redeclaring argument \"" + other.name + "\"", arg[1].line); return commands; }
+			}
+			arguments.push_back(Variable(arg[1].value.strVal, type->type_id));
+		}
+		if (auto* overloadings = state->FindFunctions(name.value.strVal); overloadings)
+		{
+			for (auto id : *overloadings)
+			{
+				if (state->functions_global_table[id].args.size() == arguments.size()) { Logger::Get().PrintLogicError("Redeclaring function \"" + name.value.strVal + "\" with " + std::to_string(arguments.size()) + " arguments.", name.line); return commands; }
+			}
+		}
+
+		//Function is added before body: it can call itself
+		Function function(name.value.strVal, return_type->type_id, arguments);
+		state->AddFunctionToCurrentSpace(function);
+		commands.push_back(PseudoCommand(PseudoOpCode::DeclareFunction, { {PseudoCodeInfo::Get().functionID_name, function.function_id} }));
+
+		//-------Arguments-------
+		ASTNode scope_start;
+		scope_start.tokens.push_back(Token(TokenType::COMPILATION_LABEL, (uint64_t)CompilationLabel::OPEN_VISIBLE_SCOPE, -1));
+		auto pc_scope_start = ex_decoder.DecodeExpression(scope_start, state);
+		commands.push_back(pc_scope_start.back());		//Function is the exception in ASTBuilder (OpenVisibleScope/CloseVisibleScope auto inserting is disable)
+		for (auto& argument : arguments)
+		{
+			state->AddVariableToCurrentSpace(argument);
+			PseudoCommand declare_cmd(PseudoOpCode::DeclareVariable);
+			declare_cmd.parameters[PseudoCodeInfo::Get().variableID_name] = argument.variable_id;
+			declare_cmd.parameters[PseudoCodeInfo::Get().typeID_name] = argument.type_id;
+			commands.push_back(declare_cmd);
+		}
+		//-------Body-------
+		for (ASTNode child : node.children) {
+			auto childChain = rh(child, state);
+			commands.insert(commands.end(), childChain.begin(), childChain.end());
+		}
+		ASTNode scope_end;
+		scope_end.tokens.push_back(Token(TokenType::COMPILATION_LABEL, (uint64_t)CompilationLabel::CLOSE_VISIBLE_SCOPE));
+		auto pc_scope_end = ex_decoder.DecodeExpression(scope_end, state);
+		commands.push_back(pc_scope_end.back());
+		commands.push_back(PseudoCommand(PseudoOpCode::DeclareFunctionEnd, { {PseudoCodeInfo::Get().functionID_name, function.function_id} }));
+		return commands;
+	}
+
 	std::vector<PseudoCommand> BasicSyntaxPseudoDecoder::HandleBasicSyntax(const ASTNode& node, std::shared_ptr<CompilationState> state, recursive_handler rh)
 	{
 		std::vector<PseudoCommand> result;
@@ -332,6 +424,10 @@ namespace Malachite
 			{
 				result = ParseCycles(node, state,rh);
 			}
+			if (node.tokens[0].value.strVal == SyntaxInfoKeywords::Get().keyword_func)
+			{
+				result = ParseFunctionBlock(node, state, rh);
+			}
 		}
 
 
@@ -410,6 +506,7 @@ namespace Malachite
 			std::vector<PseudoCommand> block_commands;
 
 			uint64_t exit_label_id = SIZE_MAX;	//Label for exit, if condition is false
+			size_t branch_line = child_node.tokens[0].line;		//Line of if/elif/else, block node doesnt have its own
 			if (child_node.tokens[0].value.strVal != SyntaxInfoKeywords::Get().keyword_else)
 			{
 				exit_label_id = PseudoCodeInfo::Get().GetNewLabelID();
@@ -417,6 +514,7 @@ namespace Malachite
 				auto condition_commands = ex_decoder.DecodeExpression(condition_tokens, state);
 				block_commands.insert(block_commands.end(), condition_commands.begin(), condition_commands.end());
 				block_commands.push_back(PseudoCommand(PseudoOpCode::JumpNotIf, { {PseudoCodeInfo::Get().labelID_name, TokenValue(exit_label_id)} }));	//op_code, where
+				for (auto& command : block_commands) if (command.line == 0) command.line = branch_line;
 
 			}
 
@@ -433,6 +531,7 @@ namespace Malachite
 			{
 				auto operation_tokens = StringOperations::TrimVector<Token>(child_node.tokens, condition_end_index + 2, child_node.tokens.size() - 1);		// +2 - skip :
 				auto operation_commands = ex_decoder.DecodeExpression(operation_tokens, state);
+				for (auto& command : operation_commands) command.line = branch_line;
 				block_commands.insert(block_commands.end(), operation_commands.begin(), operation_commands.end());
 			}
 			//Insert jump's label and exit's jump
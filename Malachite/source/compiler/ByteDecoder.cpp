@@ -1,5 +1,7 @@
 ﻿#include "..\..\include\compiler\ByteDecoder.hpp"
 #include <stack>
+#include <algorithm>
+#include <functional>
 namespace Malachite 
 {
 
@@ -21,21 +23,57 @@ namespace Malachite
 				VariableInfo vi;
 				vi.depth = current_BDS.current_depth;
 				vi.stack_offset = current_BDS.frame_size_stack.top();
+				auto planned = current_BDS.slot_offsets.find(var.variable_id);
+				if (planned != current_BDS.slot_offsets.end()) vi.stack_offset = planned->second;
 				current_BDS.variable_depth[var.variable_id] = vi;
-				if (type.category == Type::Category::PRIMITIVE) current_BDS.frame_size_stack.top() += type.size;
-				if (type.category == Type::Category::CLASS) current_BDS.frame_size_stack.top() += sizeof(MalachiteCore::Pointer);
-				//if (type.category == Type::Category::ALIAS) frame_size_stack.top();
-				//{
-				//	//letter. Alias its common pseudoname of some type, if parent type is primitive -> push type.size, if class -> push pointer size
-				//}
-				//We need to push stack pointer
-				std::cout << var.name << "|" << vi.stack_offset << "|" << vi.depth << "|" << type.size << "\n";
-				result.push_back(MalachiteCore::VMCommand(MalachiteCore::OpCode::OP_PUSH,type.size,0));	//Take trash from zero register for pulling variable's space 
+				current_BDS.frame_size_stack.top() = std::max(current_BDS.frame_size_stack.top(), vi.stack_offset + GetSlotSize(type));
+				//Slot is reserved by OP_CREATE_FRAME of the frame, its size is set when the frame's scope is closed
+				if (current_BDS.current_function != 0 && vi.depth == current_BDS.functions.at(current_BDS.current_function).depth)
+				{
+					//Arguments come in the call registers window
+					auto& args = current_BDS.current_state->functions_global_table.at(current_BDS.current_function).args;
+					for (size_t i = 0; i < args.size(); i++)
+					{
+						if (args[i].variable_id != var.variable_id) continue;
+						result.push_back(GetStoreCommand(vi, GetSlotSize(type), CallRegistersStart + i, current_BDS));
+						break;
+					}
+				}
 				break;
 			}
 			case PseudoOpCode::DeclareFunction:
 			{
-				//Cycle with calling HandleCommand before we meet a label with value FUNCTION_END
+				functionID id = cmd.parameters[PseudoCodeInfo::Get().functionID_name].uintVal;
+				if (current_BDS.current_function != 0)
+				{
+					Logger::Get().PrintLogicError("Function cant be declared in another function.", current_BDS.ip);
+					break;
+				}
+				if (current_BDS.current_depth != StartDepth + 1)
+				{
+					//Outer variables are addressed from stack start: only frame of the program has known place
+					Logger::Get().PrintLogicError("Function cant be declared in a scope with own frame (flatten_scopes is off).", current_BDS.ip);
+					break;
+				}
+				//Body is placed here, declaration jumps over it
+				FunctionInfo info;
+				info.skip_jump = current_BDS.current_commands->size();
+				info.entry = info.skip_jump + 1;
+				result.push_back(MalachiteCore::VMCommand(MalachiteCore::OpCode::OP_JMP));
+				current_BDS.functions[id] = info;
+				current_BDS.current_function = id;
+				break;
+			}
+			case PseudoOpCode::DeclareFunctionEnd:
+			{
+				functionID id = cmd.parameters[PseudoCodeInfo::Get().functionID_name].uintVal;
+				if (current_BDS.current_function != id)
+				{
+					Logger::Get().PrintLogicError("DeclareFunctionEnd without DeclareFunction.", current_BDS.ip);
+					break;
+				}
+				CloseFunction(id, current_BDS);
+				current_BDS.current_function = 0;
 				break;
 			}
 			default:
@@ -45,34 +83,288 @@ namespace Malachite
 		}
 		return result;
 	}
-	
-	std::vector<MalachiteCore::VMCommand> ByteDecoder::HandleCommand(const std::vector<PseudoCommand>& cmds, ByteDecodingState& current_BDS)
+
+	std::vector<MalachiteCore::VMCommand> ByteDecoder::HandleScopeCommand(const std::vector<PseudoCommand>& cmds, ByteDecodingState& current_BDS)
 	{
 		std::vector<MalachiteCore::VMCommand> result;
 		PseudoCommand pd = cmds[current_BDS.ip];
-		//SCOPE START/END
-		if (pd.op_code == PseudoOpCode::OpenVisibleScope)
+		switch (pd.op_code)
+		{
+			case PseudoOpCode::OpenVisibleScope:
+			{
+				//Program and function bodies always have frames, another scopes only without flatten_scopes
+				bool function_body = current_BDS.ip > 0 && cmds[current_BDS.ip - 1].op_code == PseudoOpCode::DeclareFunction;
+				if (decoder_options.flatten_scopes && !current_BDS.scope_stack.empty() && !function_body)
+				{
+					current_BDS.scope_stack.push_back(ScopeInfo{ false, current_BDS.frame_size_stack.top() });
+					break;
+				}
+				if (function_body && current_BDS.functions.count(current_BDS.current_function))
+				{
+					//Frame of function's body is created by OP_CALL, data stack isnt used
+					current_BDS.frame_size_stack.push(0);
+					current_BDS.scope_stack.push_back(ScopeInfo{ true, 0, 0, 0, true });
+					current_BDS.current_depth++;
+					FunctionInfo& function = current_BDS.functions.at(current_BDS.current_function);
+					function.depth = current_BDS.current_depth;
+					function.scope = current_BDS.scope_stack.size() - 1;
+					if (decoder_options.align_slots) PlanFrameSlots(cmds, current_BDS);
+					break;
+				}
+				//Creates frame in the vm data stack, size of its variables is set on scope's close
+				result.push_back(MalachiteCore::VMCommand(MalachiteCore::OpCode::OP_CREATE_FRAME));
+				current_BDS.frame_size_stack.push(0);
+				current_BDS.scope_stack.push_back(ScopeInfo{ true, 0, 0, current_BDS.current_commands->size() });
+				current_BDS.current_depth++;
+				if (decoder_options.align_slots) PlanFrameSlots(cmds, current_BDS);
+				break;
+			}
+			case PseudoOpCode::CloseVisibleScope:
+			{
+				if (current_BDS.scope_stack.empty())
+				{
+					Logger::Get().PrintLogicError("CloseVisibleScope close too many scopes.", current_BDS.ip);
+					break;
+				}
+				ScopeInfo scope = current_BDS.scope_stack.back();
+				current_BDS.scope_stack.pop_back();
+				current_BDS.registers_table.Clear();	//Clears register after scope's exit
+				uint64_t slots_size = std::max(scope.slots_max, current_BDS.frame_size_stack.top());
+				if (!scope.frame)
+				{
+					ScopeInfo& parent = current_BDS.scope_stack.back();	//Flattened scope is always nested
+					parent.slots_max = std::max(parent.slots_max, slots_size);
+					current_BDS.frame_size_stack.top() = scope.slots_start;
+					break;
+				}
+				if (decoder_options.align_slots) slots_size = (slots_size + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);	//Next frame pointer keeps alignment
+				if (scope.call_frame)
+				{
+					current_BDS.functions.at(current_BDS.current_function).frame_size = slots_size;	//Saved registers are added by DeclareFunctionEnd
+					current_BDS.frame_size_stack.pop();
+					current_BDS.current_depth--;
+					break;
+				}
+				(*current_BDS.current_commands)[scope.frame_command].destination = slots_size;	//One reservation instead of push per variable
+				result.push_back(MalachiteCore::VMCommand(MalachiteCore::OpCode::OP_DESTROY_FRAME));	//Destroes frame in the vm data stack
+				current_BDS.frame_size_stack.pop();
+				current_BDS.current_depth--;
+				break;
+			}
+			case PseudoOpCode::CloseVisibleScopes:
+			{
+				//Only real frames are destroyed, flattened scopes are left by jump
+				uint64_t scopes = pd.parameters[PseudoCodeInfo::Get().valueID_name].uintVal;
+				uint64_t frames = 0;
+				for (size_t i = current_BDS.scope_stack.size(); i > 0 && scopes > 0; i--, scopes--)
+				{
+					if (current_BDS.scope_stack[i - 1].frame) frames++;
+				}
+				if (frames == 0) break;
+				result.push_back(MalachiteCore::VMCommand(MalachiteCore::OpCode::OP_DESTROY_FRAMES));	//Destroes frame in the vm data stack
+				result.back().destination = frames;
+				break;
+			}
+			default:
+				break;
+		}
+		return result;
+	}
+
+	uint64_t ByteDecoder::GetSlotSize(const Type& type)
+	{
+		if (type.category == Type::Category::PRIMITIVE) return type.size;
+		if (type.category == Type::Category::CLASS) return sizeof(MalachiteCore::Pointer);
+		//if (type.category == Type::Category::ALIAS)
+		//{
+		//	//letter. Alias its common pseudoname of some type, if parent type is primitive -> push type.size, if class -> push pointer size
+		//}
+		return 0;
+	}
+
+	MalachiteCore::VMCommand ByteDecoder::GetLoadCommand(const VariableInfo& info, uint64_t size, uint64_t reg, const ByteDecodingState& current_BDS)
+	{
+		if (info.depth == current_BDS.current_depth)
+		{
+			return MalachiteCore::VMCommand(MalachiteCore::GetWidthOpCode(MalachiteCore::OpCode::OP_LOAD_LOCAL, size), reg, info.stack_offset, size);
+		}
+		uint64_t size_and_depth = size << 32;	//0...size -> size...0 //uint64_t and int64_t size...0 -> size...depth
+		if (current_BDS.current_function == 0)
+		{
+			size_and_depth |= info.depth;
+			return MalachiteCore::VMCommand(MalachiteCore::GetWidthOpCode(MalachiteCore::OpCode::OP_LOAD_ENCLOSING_A, size), reg, info.stack_offset, size_and_depth);
+		}
+		if (info.depth < current_BDS.functions.at(current_BDS.current_function).depth)
+		{
+			//Global variable: functions are declared only in program's frame, it starts at stack start. The caller's frames are unknown
+			return MalachiteCore::VMCommand(MalachiteCore::GetWidthOpCode(MalachiteCore::OpCode::OP_LOAD_STACK, size), reg, info.stack_offset, size);
+		}
+		size_and_depth |= current_BDS.current_depth - 1 - info.depth;	//Frames of function are counted from the top of data stack
+		return MalachiteCore::VMCommand(MalachiteCore::GetWidthOpCode(MalachiteCore::OpCode::OP_LOAD_ENCLOSING_R, size), reg, info.stack_offset, size_and_depth);
+	}
+
+	MalachiteCore::VMCommand ByteDecoder::GetStoreCommand(const VariableInfo& info, uint64_t size, uint64_t reg, const ByteDecodingState& current_BDS)
+	{
+		if (info.depth == current_BDS.current_depth)
+		{
+			return MalachiteCore::VMCommand(MalachiteCore::GetWidthOpCode(MalachiteCore::OpCode::OP_STORE_LOCAL, size), info.stack_offset, reg, size);
+		}
+		uint64_t size_and_depth = size << 32;
+		if (current_BDS.current_function == 0)
 		{
-			result.push_back(MalachiteCore::VMCommand(MalachiteCore::OpCode::OP_CREATE_FRAME));	//Creates frame in the vm data stack
-			current_BDS.frame_size_stack.push(0);
-			current_BDS.current_depth++;
+			size_and_depth |= info.depth;
+			return MalachiteCore::VMCommand(MalachiteCore::GetWidthOpCode(MalachiteCore::OpCode::OP_STORE_ENCLOSING_A, size), info.stack_offset, reg, size_and_depth);
 		}
-		if (pd.op_code == PseudoOpCode::CloseVisibleScope)
+		if (info.depth < current_BDS.functions.at(current_BDS.current_function).depth)
 		{
-			if (current_BDS.current_depth == StartDepth)
+			return MalachiteCore::VMCommand(MalachiteCore::GetWidthOpCode(MalachiteCore::OpCode::OP_STORE_STACK, size), info.stack_offset, reg, size);
+		}
+		size_and_depth |= current_BDS.current_depth - 1 - info.depth;
+		return MalachiteCore::VMCommand(MalachiteCore::GetWidthOpCode(MalachiteCore::OpCode::OP_STORE_ENCLOSING_R, size), info.stack_offset, reg, size_and_depth);
+	}
+
+	void ByteDecoder::CloseFunction(functionID id, ByteDecodingState& current_BDS)
+	{
+		FunctionInfo& function = current_BDS.functions.at(id);
+		std::vector<MalachiteCore::VMCommand>& commands = *current_BDS.current_commands;
+
+		//Callee-saved registers: every register written by the body, except the call window
+		std::bitset<MalachiteCore::REGISTER_COUNT> written;
+		for (size_t i = function.entry; i < commands.size(); i++)
+		{
+			auto role = MalachiteCore::GetOperandRoles(commands[i].operation).destination;
+			if ((role == MalachiteCore::ROLE_WRITE || role == MalachiteCore::ROLE_READ_WRITE) && commands[i].destination < CallRegistersStart) written.set(commands[i].destination);
+		}
+		std::vector<uint64_t> saved;
+		for (uint64_t reg = 0; reg < CallRegistersStart; reg++)
+		{
+			if (written.test(reg)) saved.push_back(reg);
+		}
+		uint64_t saved_start = function.frame_size;	//Saved registers are after slots
+		function.frame_size += saved.size() * MalachiteCore::REGISTER_SIZE;
+
+		//Epilogue: end of body and returns
+		uint64_t epilogue = commands.size();
+		for (size_t i = 0; i < saved.size(); i++)
+		{
+			commands.push_back(MalachiteCore::VMCommand(MalachiteCore::GetWidthOpCode(MalachiteCore::OpCode::OP_LOAD_LOCAL, MalachiteCore::REGISTER_SIZE), saved[i], saved_start + i * MalachiteCore::REGISTER_SIZE, MalachiteCore::REGISTER_SIZE));
+		}
+		commands.push_back(MalachiteCore::VMCommand(MalachiteCore::OpCode::OP_RET));
+		for (uint64_t ip : function.returns) commands[ip].destination = epilogue;
+		for (uint64_t ip : function.calls) commands[ip].source0 = function.frame_size;
+
+		//Prologue is inserted at entry: jumps inside the body are moved, calls stay at entry
+		uint64_t prologue_size = saved.size();
+		if (prologue_size > 0)
+		{
+			for (size_t i = function.entry; i < commands.size(); i++)
+			{
+				auto& command = commands[i];
+				if (MalachiteCore::GetOperandRoles(command.operation).destination != MalachiteCore::ROLE_TARGET) continue;
+				if (command.operation == MalachiteCore::OpCode::OP_CALL && command.destination == function.entry) continue;
+				if (command.destination >= function.entry) command.destination += prologue_size;
+			}
+			for (auto& label : current_BDS.labels)
+			{
+				if (label.second >= function.entry) label.second += prologue_size;
+			}
+			for (auto& jumps : current_BDS.waiting_jumps)
+			{
+				for (auto& jump : jumps.second)
+				{
+					if (jump.second >= function.entry) jump.second += prologue_size;
+				}
+			}
+			std::vector<MalachiteCore::VMCommand> prologue;
+			for (size_t i = 0; i < saved.size(); i++)
+			{
+				prologue.push_back(MalachiteCore::VMCommand(MalachiteCore::GetWidthOpCode(MalachiteCore::OpCode::OP_STORE_LOCAL, MalachiteCore::REGISTER_SIZE), saved_start + i * MalachiteCore::REGISTER_SIZE, saved[i], MalachiteCore::REGISTER_SIZE));
+			}
+			commands.insert(commands.begin() + function.entry, prologue.begin(), prologue.end());
+			size_t line = function.skip_jump < current_BDS.lines.size() ? current_BDS.lines[function.skip_jump] : 0;	//Prologue belongs to declaration
+			current_BDS.lines.insert(current_BDS.lines.begin() + function.entry, prologue_size, line);
+		}
+		commands[function.skip_jump].destination = commands.size();
+		function.closed = true;
+	}
+
+	void ByteDecoder::PlanFrameSlots(const std::vector<PseudoCommand>& cmds, ByteDecodingState& current_BDS)
+	{
+		//Slot of size N is at fp - offset - N + 1 and fp + 1 is 8 bytes aligned, so slot is aligned if offset is multiple of its alignment
+		struct ScopeSlots
+		{
+			std::vector<std::pair<variableID, uint64_t>> slots;	//Variable and size
+			std::vector<size_t> children;						//Nested flattened scopes
+		};
+		auto alignment = [](uint64_t size) -> uint64_t
+			{
+				uint64_t align = 1;
+				while (align < sizeof(uint64_t) && size % (align * 2) == 0) align *= 2;
+				return align;
+			};
+		auto align_up = [](uint64_t offset, uint64_t align) -> uint64_t { return (offset + align - 1) / align * align; };
+
+		//Collecting: nested frames (function bodies, every scope without flatten_scopes) have own layouts
+		std::vector<ScopeSlots> scopes(1);
+		std::vector<size_t> open_scopes{ 0 };
+		for (uint64_t ip = current_BDS.ip + 1; ip < cmds.size() && !open_scopes.empty(); ip++)
+		{
+			const PseudoCommand& pd = cmds[ip];
+			if (pd.op_code == PseudoOpCode::OpenVisibleScope)
 			{
-				Logger::Get().PrintLogicError("CloseVisibleScope close too many scopes.", current_BDS.ip);
-				return result;
+				if (!decoder_options.flatten_scopes || cmds[ip - 1].op_code == PseudoOpCode::DeclareFunction)
+				{
+					for (int64_t depth = 1; depth > 0 && ip + 1 < cmds.size();)
+					{
+						ip++;
+						if (cmds[ip].op_code == PseudoOpCode::OpenVisibleScope) depth++;
+						if (cmds[ip].op_code == PseudoOpCode::CloseVisibleScope) depth--;
+					}
+					continue;
+				}
+				scopes[open_scopes.back()].children.push_back(scopes.size());
+				open_scopes.push_back(scopes.size());
+				scopes.emplace_back();
+			}
+			if (pd.op_code == PseudoOpCode::CloseVisibleScope) open_scopes.pop_back();
+			if (pd.op_code == PseudoOpCode::DeclareVariable)
+			{
+				auto parameter = pd.parameters.find(PseudoCodeInfo::Get().variableID_name);
+				if (parameter == pd.parameters.end()) continue;
+				auto var = current_BDS.current_state->variables_global_table.find(parameter->second.uintVal);
+				if (var == current_BDS.current_state->variables_global_table.end()) continue;	//Error is printed by DeclareVariable
+				auto type = current_BDS.current_state->types_global_table.find(var->second.type_id);
+				if (type == current_BDS.current_state->types_global_table.end()) continue;
+				scopes[open_scopes.back()].slots.push_back({ var->first, GetSlotSize(type->second) });
 			}
-			result.push_back(MalachiteCore::VMCommand(MalachiteCore::OpCode::OP_DESTROY_FRAME));	//Destroes frame in the vm data stack
-			current_BDS.frame_size_stack.pop();
-			current_BDS.registers_table.Clear();	//Clears register after scope's exit
-			current_BDS.current_depth--;
 		}
-		if (pd.op_code == PseudoOpCode::CloseVisibleScopes)
+
+		//Layout: the biggest alignments first (no padding between them), nested scopes after all slots of their parent and reuse the same place
+		std::function<void(size_t, uint64_t)> place = [&](size_t scope, uint64_t offset)
+			{
+				auto& slots = scopes[scope].slots;
+				std::stable_sort(slots.begin(), slots.end(), [&](const auto& a, const auto& b) { return alignment(a.second) > alignment(b.second); });
+				for (auto& slot : slots)
+				{
+					offset = align_up(offset, alignment(slot.second));
+					current_BDS.slot_offsets[slot.first] = offset;
+					offset += slot.second;
+				}
+				offset = align_up(offset, sizeof(uint64_t));
+				for (size_t child : scopes[scope].children) place(child, offset);
+			};
+		place(0, 0);
+	}
+
+	std::vector<MalachiteCore::VMCommand> ByteDecoder::HandleCommand(const std::vector<PseudoCommand>& cmds, ByteDecodingState& current_BDS)
+	{
+		std::vector<MalachiteCore::VMCommand> result;
+		PseudoCommand pd = cmds[current_BDS.ip];
+		//SCOPE START/END
+		if (pd.op_code == PseudoOpCode::OpenVisibleScope || pd.op_code == PseudoOpCode::CloseVisibleScope || pd.op_code == PseudoOpCode::CloseVisibleScopes)
 		{
-			result.push_back(MalachiteCore::VMCommand(MalachiteCore::OpCode::OP_DESTROY_FRAMES));	//Destroes frame in the vm data stack
-			result.back().destination = pd.parameters[PseudoCodeInfo::Get().valueID_name].uintVal;
+			auto result1 = HandleScopeCommand(cmds, current_BDS);
+			result.insert(result.end(), result1.begin(), result1.end());
 		}
 		//Loading/Storing
 
@@ -255,10 +547,32 @@ namespace Malachite
 		return MalachiteCore::OpCode::OP_NOP;
 	}
 
+	MalachiteCore::OpCode ByteDecoder::GetVMFusedJumpCommand(MalachiteCore::OpCode compare, uint64_t flag, bool inverse)
+	{
+		using namespace MalachiteCore;
+		// Order in OP_JMP_I*/OP_JMP_D*: EQ, NE, GT, LT, GE, LE
+		int condition = -1;
+		switch (flag)
+		{
+		case FLAG::EQUAL_FLAG: condition = inverse ? 1 : 0; break;
+		case FLAG::NOT_EQUAL_FLAG: condition = inverse ? 0 : 1; break;
+		case FLAG::GREATER_FLAG: condition = inverse ? 5 : 2; break;
+		case FLAG::LESS_FLAG: condition = inverse ? 4 : 3; break;
+		case FLAG::EQUAL_FLAG | FLAG::GREATER_FLAG: condition = inverse ? 3 : 4; break;
+		case FLAG::EQUAL_FLAG | FLAG::LESS_FLAG: condition = inverse ? 2 : 5; break;
+		default:
+			return OpCode::OP_NOP;
+		}
+		if (compare == OpCode::OP_CMP_RR) return static_cast<OpCode>(OpCode::OP_JMP_IEQ + condition);
+		if (compare == OpCode::OP_DCMP_RR) return static_cast<OpCode>(OpCode::OP_JMP_DEQ + condition);	//NaN is an error in both, so inversion is exact
+		return OpCode::OP_NOP;
+	}
+
 	std::vector<MalachiteCore::VMCommand> Malachite::ByteDecoder::PseudoToByte(std::pair<std::shared_ptr<CompilationState>, std::vector<PseudoCommand>> state)
 	{
 		ByteDecodingState current_BDS;
 		current_BDS.current_state = state.first;
+		line_table = MalachiteCore::LineTable();
 		std::vector<PseudoCommand>& code = state.second;
 
 		std::vector<MalachiteCore::VMCommand> result;
@@ -267,8 +581,10 @@ namespace Malachite
 		{
 			for (; current_BDS.ip < code.size(); current_BDS.ip++)
 			{
+				size_t line = code[current_BDS.ip].line;
 				auto commands = HandleCommand(code, current_BDS);
 				result.insert(result.end(), commands.begin(), commands.end());
+				current_BDS.lines.resize(result.size(), line);	//Commands of the handler (and epilogue of closed function)
 			}
 		}
 		catch (std::runtime_error& e) {
@@ -291,10 +607,44 @@ namespace Malachite
 					Logger::Get().PrintLogicError("LabelID: " + std::to_string(p.first) + "| Jump pseudo ip: " + std::to_string(d.first) + "| Jump byte ip: " + std::to_string(d.second), current_BDS.ip);
 				}
 			}
+			return result;	//Jump destinations are broken, optimizer cant remap them
 		}
 
+		//Labels and waiting jumps are resolved here: optimizer remaps jump destinations itself
+		ByteOptimizer optimizer(optimizer_options);
+		result = optimizer.Optimize(result);
+		ip_map = optimizer.GetIpMap();
+
+		//Removed command maps to the same ip as the next one, kept ones give their lines
+		line_table = MalachiteCore::LineTable();
+		current_BDS.lines.resize(ip_map.size() - 1, 0);
+		for (size_t ip = 0; ip + 1 < ip_map.size(); ip++)
+		{
+			if (ip_map[ip] != ip_map[ip + 1]) line_table.append(static_cast<uint32_t>(current_BDS.lines[ip]));
+		}
 		return result;
 	}
+	MalachiteCore::VMProgram ByteDecoder::Pack(const std::vector<MalachiteCore::VMCommand>& commands)
+	{
+		MalachiteCore::VMProgram program;
+		if (commands.empty()) return program;
+		if (MalachiteCore::encode_program(commands.data(), commands.size(), program) != MalachiteCore::VMError::NO_ERROR)
+		{
+			Logger::Get().PrintLogicError("Byte code cannot be packed: some operand is out of range of the packed command.", 0);
+			program.code.clear();
+			program.constants.clear();
+			return program;
+		}
+		//Not verified program still runs, with runtime checks. Code after compilation errors is half-built: it isnt verified (errors since Logger::ClearState)
+		if (Logger::Get().GetErrorCounts() == 0) MalachiteCore::verify_program(commands.data(), commands.size(), program);
+		if (line_table.commands == commands.size()) program.lines = line_table;	//Commands of the last PseudoToByte
+		return program;
+	}
+
+	MalachiteCore::VMProgram ByteDecoder::PseudoToProgram(std::pair<std::shared_ptr<CompilationState>, std::vector<PseudoCommand>> state)
+	{
+		return Pack(PseudoToByte(state));
+	}
 }
 
 
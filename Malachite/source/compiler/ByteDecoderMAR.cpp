@@ -316,16 +316,7 @@ namespace Malachite
 				size_t size = type.size;
 				if (type.category == Type::Category::PRIMITIVE)
 				{
-					if (info.depth == current_BDS.current_depth)
-					{
-						result.push_back(MalachiteCore::VMCommand(MalachiteCore::OpCode::OP_STORE_LOCAL, info.stack_offset, reg_number, type.size));
-					}
-					else
-					{
-						uint64_t size_and_depth = size << 32;	//0...size -> size...0
-						size_and_depth |= info.depth;	//uint64_t and int64_t size...0 -> size...depth
-						result.push_back(MalachiteCore::VMCommand(MalachiteCore::OpCode::OP_STORE_ENCLOSING_A, info.stack_offset, reg_number, size_and_depth));
-					}
+					result.push_back(GetStoreCommand(info, size, reg_number, current_BDS));
 				}
 				else if (type.category == Type::Category::ALIAS){}	//thinking
 				else if (type.category == Type::Category::CLASS){}
@@ -343,17 +334,7 @@ namespace Malachite
 				if (type.category == Type::Category::PRIMITIVE)
 				{
 					//PseudoDecoder checked vars validity
-					if (info.depth == current_BDS.current_depth)
-					{
-						result.push_back(MalachiteCore::VMCommand(MalachiteCore::OpCode::OP_LOAD_LOCAL, reg_number, info.stack_offset, type.size));
-
-					}
-					else //
-					{
-						uint64_t size_and_depth = size << 32;	//0...size -> size...0
-						size_and_depth |= info.depth;	//uint64_t and int64_t size...0 -> size...depth
-						result.push_back(MalachiteCore::VMCommand(MalachiteCore::OpCode::OP_LOAD_ENCLOSING_A, reg_number, info.stack_offset, size_and_depth));
-					}
+					result.push_back(GetLoadCommand(info, size, reg_number, current_BDS));
 					if (type.vm_analog == Type::VMAnalog::NONE)
 					{
 						Logger::Get().PrintLogicError("Primitive type \"" + type.name + "\" hasnt analog in the Malachite Virtual Machine.Instruction pointer of pseudo code : " + std::to_string(current_BDS.ip), current_BDS.ip);
@@ -505,6 +486,46 @@ namespace Malachite
 	{
 		std::vector<MalachiteCore::VMCommand> result;
 		PseudoCommand cmd = cmds[current_BDS.ip];
+		//If the condition is a comparison result: CMP/DCMP + GET_FLAG + JMP_CV/JMP_CNV -> one fused command
+		auto fused_jump_handler = [&](const ValueFrame& condition, bool inverse, uint64_t l_id) -> bool
+			{
+				if (current_BDS.ip == 0) return false;
+				switch (cmds[current_BDS.ip - 1].op_code)
+				{
+				case PseudoOpCode::Equal:
+				case PseudoOpCode::NotEqual:
+				case PseudoOpCode::Greater:
+				case PseudoOpCode::Less:
+				case PseudoOpCode::GreaterEqual:
+				case PseudoOpCode::LessEqual:
+					break;
+				default:
+					return false;
+				}
+				auto& commands = *current_BDS.current_commands;
+				if (commands.size() < 2) return false;
+				const MalachiteCore::VMCommand& compare = commands[commands.size() - 2];
+				const MalachiteCore::VMCommand& get_flag = commands.back();
+				if (get_flag.operation != MalachiteCore::OpCode::OP_GET_FLAG || get_flag.destination != condition.used_register) return false;
+
+				MalachiteCore::OpCode fused = GetVMFusedJumpCommand(compare.operation, get_flag.source0, inverse);
+				if (fused == MalachiteCore::OpCode::OP_NOP) return false;
+				uint64_t first = compare.source0;
+				uint64_t second = compare.source1;
+				commands.pop_back();
+				commands.pop_back();
+
+				if (!current_BDS.labels.count(l_id))
+				{
+					current_BDS.waiting_jumps[l_id].push_back({ current_BDS.ip,commands.size() });
+					result.push_back(MalachiteCore::VMCommand(fused, l_id, first, second));
+				}
+				else
+				{
+					result.push_back(MalachiteCore::VMCommand(fused, current_BDS.labels[l_id], first, second));
+				}
+				return true;
+			};
 		switch (cmd.op_code)
 		{
 			case PseudoOpCode::Jump:
@@ -547,7 +568,8 @@ namespace Malachite
 				}
 				uint64_t l_id = cmd.parameters[PseudoCodeInfo::Get().labelID_name].uintVal;
 
-				if (!current_BDS.labels.count(l_id))
+				if (fused_jump_handler(left, false, l_id)) {}	//Fused command has been emitted
+				else if (!current_BDS.labels.count(l_id))
 				{
 					current_BDS.waiting_jumps[l_id].push_back({ current_BDS.ip,current_BDS.current_commands->size() });
 					result.push_back(MalachiteCore::VMCommand(
@@ -581,7 +603,8 @@ namespace Malachite
 				}
 				uint64_t l_id = cmd.parameters[PseudoCodeInfo::Get().labelID_name].uintVal;
 
-				if (!current_BDS.labels.count(l_id))
+				if (fused_jump_handler(left, true, l_id)) {}	//Fused command has been emitted
+				else if (!current_BDS.labels.count(l_id))
 				{
 					current_BDS.waiting_jumps[l_id].push_back({ current_BDS.ip,current_BDS.current_commands->size() });
 					result.push_back(MalachiteCore::VMCommand(
@@ -601,6 +624,105 @@ namespace Malachite
 				current_BDS.registers_table.Release(left.used_register);
 			}
 			break;
+			case PseudoOpCode::Call:
+			{
+				functionID id = cmd.parameters[PseudoCodeInfo::Get().functionID_name].uintVal;
+				bool is_host = current_BDS.current_state->functions_global_table.count(id) && current_BDS.current_state->functions_global_table.at(id).host_index != MalachiteCore::HostRegistry::INVALID_INDEX;
+				if (!is_host && !current_BDS.functions.count(id))
+				{
+					Logger::Get().PrintLogicError("Function with id = " + std::to_string(id) + " isnt declared.", current_BDS.ip);
+					break;
+				}
+				Function& function = current_BDS.current_state->functions_global_table.at(id);
+				if (function.args.size() > CallRegistersCount)
+				{
+					Logger::Get().PrintLogicError("Function \"" + function.name + "\" has more than " + std::to_string(CallRegistersCount) + " arguments.", current_BDS.ip);
+					break;
+				}
+				if (current_BDS.value_stack.size() < function.args.size())
+				{
+					Logger::Get().PrintTypeError("Function \"" + function.name + "\" needs " + std::to_string(function.args.size()) + " arguments.", current_BDS.ip);
+					break;
+				}
+				//Arguments: the last is on the top of values stack
+				for (size_t i = function.args.size(); i-- > 0;)
+				{
+					ValueFrame vf = current_BDS.value_stack.top(); current_BDS.value_stack.pop();
+					Type& type = current_BDS.current_state->types_global_table.at(function.args[i].type_id);
+					auto conv_cmd_opcode = GetVMTypeConvertionCommand(vf.value_type, type.vm_analog);
+					if (conv_cmd_opcode != MalachiteCore::OpCode::OP_NOP) result.push_back(MalachiteCore::VMCommand(conv_cmd_opcode, vf.used_register));
+					result.push_back(MalachiteCore::VMCommand(MalachiteCore::OpCode::OP_MOV_RR, CallRegistersStart + i, vf.used_register));
+					current_BDS.registers_table.Release(vf.used_register);
+				}
+				if (is_host)	//Arguments are in the window already, result is written to its first register
+				{
+					result.push_back(MalachiteCore::VMCommand(MalachiteCore::OpCode::OP_CALL_HOST, function.host_index, CallRegistersStart, function.args.size()));
+				}
+				else
+				{
+					FunctionInfo& info = current_BDS.functions.at(id);
+					if (!info.closed) info.calls.push_back(current_BDS.current_commands->size() + result.size());	//Recursive call, frame size is set on function's end
+					result.push_back(MalachiteCore::VMCommand(MalachiteCore::OpCode::OP_CALL, info.entry, info.frame_size));
+				}
+
+				Type& return_type = current_BDS.current_state->types_global_table.at(function.return_type);
+				if (return_type.vm_analog == Type::VMAnalog::NONE) break;	//void
+				auto free_register = current_BDS.registers_table.Allocate();
+				if (free_register == InvalidRegister)
+				{
+					Logger::Get().PrintLogicError("All registers are in using. Instruction pointer of pseudo code: " + std::to_string(current_BDS.ip), current_BDS.ip);
+					break;
+				}
+				result.push_back(MalachiteCore::VMCommand(MalachiteCore::OpCode::OP_MOV_RR, free_register, CallRegistersStart));
+				current_BDS.value_stack.push(ValueFrame(free_register, return_type.vm_analog));
+			}
+			break;
+			case PseudoOpCode::Return:
+			{
+				if (current_BDS.current_function == 0)
+				{
+					Logger::Get().PrintLogicError(SyntaxInfo::GetPseudoString(cmd.op_code) + " is outside of function.", current_BDS.ip);
+					break;
+				}
+				FunctionInfo& info = current_BDS.functions.at(current_BDS.current_function);
+				Function& function = current_BDS.current_state->functions_global_table.at(current_BDS.current_function);
+				Type& return_type = current_BDS.current_state->types_global_table.at(function.return_type);
+				bool has_value = cmd.parameters[PseudoCodeInfo::Get().valueID_name].uintVal != 0;
+				bool is_void = return_type.vm_analog == Type::VMAnalog::NONE;
+				if (!has_value && !is_void)
+				{
+					Logger::Get().PrintTypeError("Function \"" + function.name + "\" has to return a value of type \"" + return_type.name + "\".", current_BDS.ip);
+					break;
+				}
+				if (has_value && is_void)
+				{
+					Logger::Get().PrintTypeError("Function \"" + function.name + "\" returns void.", current_BDS.ip);
+					break;
+				}
+				if (has_value)
+				{
+					if (current_BDS.value_stack.size() < 1)
+					{
+						Logger::Get().PrintTypeError(SyntaxInfo::GetPseudoString(cmd.op_code) + " needs a value.", current_BDS.ip);
+						break;
+					}
+					ValueFrame vf = current_BDS.value_stack.top(); current_BDS.value_stack.pop();
+					auto conv_cmd_opcode = GetVMTypeConvertionCommand(vf.value_type, return_type.vm_analog);
+					if (conv_cmd_opcode != MalachiteCore::OpCode::OP_NOP) result.push_back(MalachiteCore::VMCommand(conv_cmd_opcode, vf.used_register));
+					result.push_back(MalachiteCore::VMCommand(MalachiteCore::OpCode::OP_MOV_RR, CallRegistersStart, vf.used_register));
+					current_BDS.registers_table.Release(vf.used_register);
+				}
+				//Frames created in function's body, function's frame is destroyed by OP_RET
+				uint64_t frames = 0;
+				for (size_t i = info.scope + 1; i < current_BDS.scope_stack.size(); i++)
+				{
+					if (current_BDS.scope_stack[i].frame) frames++;
+				}
+				if (frames > 0) result.push_back(MalachiteCore::VMCommand(MalachiteCore::OpCode::OP_DESTROY_FRAMES, frames));
+				info.returns.push_back(current_BDS.current_commands->size() + result.size());	//Epilogue is known on function's end
+				result.push_back(MalachiteCore::VMCommand(MalachiteCore::OpCode::OP_JMP));
+			}
+			break;
 			case PseudoOpCode::Label:
 			{
 				uint64_t l_id = cmd.parameters[PseudoCodeInfo::Get().labelID_name].uintVal;
@@ -692,17 +814,7 @@ namespace Malachite
 			if (type.category == Type::Category::PRIMITIVE)
 			{
 				//PseudoDecoder checked vars validity
-				if (info.depth == current_BDS.current_depth)
-				{
-					result.push_back(MalachiteCore::VMCommand(MalachiteCore::OpCode::OP_LOAD_LOCAL, free_register, info.stack_offset, type.size));
-
-				}
-				else //
-				{
-					uint64_t size_and_depth = size << 32;	//0...size -> size...0
-					size_and_depth |= info.depth;	
-					result.push_back(MalachiteCore::VMCommand(MalachiteCore::OpCode::OP_LOAD_ENCLOSING_A, free_register, info.stack_offset, size_and_depth));
-				}
+				result.push_back(GetLoadCommand(info, size, free_register, current_BDS));
 				if (type.vm_analog == Type::VMAnalog::NONE)
 				{
 					Logger::Get().PrintLogicError("Primitive type \"" + type.name + "\" hasnt analog in the Malachite Virtual Machine.Instruction pointer of pseudo code : " + std::to_string(current_BDS.ip), current_BDS.ip);
@@ -749,17 +861,7 @@ namespace Malachite
 						result.push_back(MalachiteCore::VMCommand(conv_cmd_opcode, vf.used_register));
 					}
 				}
-				if (info.depth == current_BDS.current_depth)
-				{
-					result.push_back(MalachiteCore::VMCommand(MalachiteCore::OpCode::OP_STORE_LOCAL, info.stack_offset, vf.used_register, type.size));
-				}
-				else //
-				{
-					std::cout << var.name << "|" << info.stack_offset << "|" << info.depth << "|" << size << "|" << vf.used_register << "\n";
-					uint64_t size_and_depth = size << 32;	//0...size -> size...0 //uint64_t and int64_t size...0 -> size...depth
-					size_and_depth |= info.depth;	// depth -1 corrects ENCLOSING
-					result.push_back(MalachiteCore::VMCommand(MalachiteCore::OpCode::OP_STORE_ENCLOSING_A, info.stack_offset, vf.used_register, size_and_depth));
-				}
+				result.push_back(GetStoreCommand(info, size, vf.used_register, current_BDS));
 				current_BDS.registers_table.Release(vf.used_register);
 				return result;
 			}
@@ -0,0 +1,234 @@
+#include "..\..\include\compiler\ByteOptimizer.hpp"
+
+namespace Malachite
+{
+	namespace
+	{
+		//Size of the value stored/loaded by a memory command, 0 if command isnt a memory command
+		uint64_t GetAccessSize(const MalachiteCore::VMCommand& command)
+		{
+			uint64_t width = MalachiteCore::GetOpCodeWidth(command.operation);
+			if (width != 0) return width;
+			if (MalachiteCore::IsEnclosingOpCode(command.operation)) return command.source1 >> 32;
+			return command.source1;
+		}
+
+		bool IsRegister(uint64_t operand)
+		{
+			return operand < MalachiteCore::REGISTER_COUNT;
+		}
+	}
+
+	std::vector<bool> ByteOptimizer::FindJumpTargets(const std::vector<MalachiteCore::VMCommand>& commands)
+	{
+		std::vector<bool> jump_targets(commands.size() + 1, false);
+		for (auto& command : commands)
+		{
+			if (MalachiteCore::GetOperandRoles(command.operation).destination != MalachiteCore::ROLE_TARGET) continue;
+			if (command.destination <= commands.size()) jump_targets[command.destination] = true;
+		}
+		return jump_targets;
+	}
+
+	std::vector<ByteOptimizer::RegisterSet> ByteOptimizer::ComputeLiveOut(const std::vector<MalachiteCore::VMCommand>& commands)
+	{
+		size_t size = commands.size();
+		std::vector<RegisterSet> uses(size), defs(size), live_in(size), live_out(size);
+		RegisterSet all;
+		all.set();
+
+		for (size_t i = 0; i < size; i++)
+		{
+			auto& command = commands[i];
+			auto roles = MalachiteCore::GetOperandRoles(command.operation);
+			auto add = [&](MalachiteCore::OperandRole role, uint64_t operand)
+				{
+					if (!IsRegister(operand)) return;
+					if (role == MalachiteCore::ROLE_READ || role == MalachiteCore::ROLE_READ_WRITE) uses[i].set(operand);
+					if (role == MalachiteCore::ROLE_WRITE) defs[i].set(operand);
+				};
+			add(roles.destination, command.destination);
+			add(roles.source0, command.source0);
+			add(roles.source1, command.source1);
+		}
+
+		//Backward dataflow. Registers are visible outside after RET, CALL, CALL_HOST, HALT and the end of code -> all are live there
+		bool changed = true;
+		while (changed)
+		{
+			changed = false;
+			for (size_t i = size; i-- > 0;)
+			{
+				auto& command = commands[i];
+				RegisterSet out;
+				if (command.operation == MalachiteCore::OpCode::OP_RET || command.operation == MalachiteCore::OpCode::OP_CALL || command.operation == MalachiteCore::OpCode::OP_CALL_HOST || command.operation == MalachiteCore::OpCode::OP_HALT)
+				{
+					out = all;
+				}
+				else
+				{
+					if (!MalachiteCore::IsTerminatorOpCode(command.operation))
+					{
+						out |= i + 1 < size ? live_in[i + 1] : all;
+					}
+					if (MalachiteCore::GetOperandRoles(command.operation).destination == MalachiteCore::ROLE_TARGET)
+					{
+						out |= command.destination < size ? live_in[command.destination] : all;
+					}
+				}
+				RegisterSet in = uses[i] | (out & ~defs[i]);
+				if (in != live_in[i] || out != live_out[i])
+				{
+					live_in[i] = in;
+					live_out[i] = out;
+					changed = true;
+				}
+			}
+		}
+		return live_out;
+	}
+
+	bool ByteOptimizer::ForwardStores(std::vector<MalachiteCore::VMCommand>& commands, std::vector<bool>& removed, const std::vector<bool>& jump_targets)
+	{
+		bool changed = false;
+		for (size_t i = 0; i + 1 < commands.size(); i++)
+		{
+			if (removed[i] || removed[i + 1] || jump_targets[i + 1]) continue;
+			auto& store = commands[i];
+			auto& load = commands[i + 1];
+			MalachiteCore::OpCode store_op = MalachiteCore::GetGenericOpCode(store.operation);
+			MalachiteCore::OpCode load_op = MalachiteCore::GetGenericOpCode(load.operation);
+
+			bool same_slot = false;
+			if (store_op == MalachiteCore::OpCode::OP_STORE_LOCAL && load_op == MalachiteCore::OpCode::OP_LOAD_LOCAL) same_slot = store.destination == load.source0;
+			if (store_op == MalachiteCore::OpCode::OP_STORE_ENCLOSING_A && load_op == MalachiteCore::OpCode::OP_LOAD_ENCLOSING_A) same_slot = store.destination == load.source0 && store.source1 == load.source1;
+			if (store_op == MalachiteCore::OpCode::OP_STORE_ENCLOSING_R && load_op == MalachiteCore::OpCode::OP_LOAD_ENCLOSING_R) same_slot = store.destination == load.source0 && store.source1 == load.source1;
+			//Smaller values are truncated by store, register keeps all bits
+			if (!same_slot || GetAccessSize(store) != MalachiteCore::REGISTER_SIZE || GetAccessSize(load) != MalachiteCore::REGISTER_SIZE) continue;
+
+			if (load.destination == store.source0) removed[i + 1] = true;
+			else load = MalachiteCore::VMCommand(MalachiteCore::OpCode::OP_MOV_RR, load.destination, store.source0);
+			changed = true;
+			i++;
+		}
+		return changed;
+	}
+
+	bool ByteOptimizer::CollapseMoves(std::vector<MalachiteCore::VMCommand>& commands, std::vector<bool>& removed, const std::vector<bool>& jump_targets)
+	{
+		bool changed = false;
+		auto live_out = ComputeLiveOut(commands);
+		for (size_t i = 0; i < commands.size(); i++)
+		{
+			if (removed[i]) continue;
+			auto& command = commands[i];
+			if (command.operation == MalachiteCore::OpCode::OP_MOV_RR && command.destination == command.source0)
+			{
+				removed[i] = true;
+				changed = true;
+				continue;
+			}
+			if (i + 1 >= commands.size() || removed[i + 1] || jump_targets[i + 1]) continue;
+
+			auto& move = commands[i + 1];
+			if (move.operation != MalachiteCore::OpCode::OP_MOV_RR || move.source0 != command.destination) continue;
+			if (MalachiteCore::GetOperandRoles(command.operation).destination != MalachiteCore::ROLE_WRITE) continue;
+			if (!IsRegister(command.destination) || live_out[i + 1].test(command.destination)) continue;
+
+			//Result is written directly to the register of MOV_RR
+			command.destination = move.destination;
+			removed[i + 1] = true;
+			changed = true;
+			i++;
+		}
+		return changed;
+	}
+
+	bool ByteOptimizer::MarkUseless(const std::vector<MalachiteCore::VMCommand>& commands, std::vector<bool>& removed)
+	{
+		bool changed = false;
+		for (size_t i = 0; i < commands.size(); i++)
+		{
+			if (removed[i]) continue;
+			auto& command = commands[i];
+			bool useless = false;
+			if (options.remove_nops && command.operation == MalachiteCore::OpCode::OP_NOP) useless = true;
+			if (options.remove_jumps_to_next && command.destination == i + 1)
+			{
+				switch (command.operation)
+				{
+				case MalachiteCore::OpCode::OP_JMP:
+				case MalachiteCore::OpCode::OP_JMP_CV:
+				case MalachiteCore::OpCode::OP_JMP_CNV:
+				case MalachiteCore::OpCode::OP_JMP_IEQ:
+				case MalachiteCore::OpCode::OP_JMP_INE:
+				case MalachiteCore::OpCode::OP_JMP_IGT:
+				case MalachiteCore::OpCode::OP_JMP_ILT:
+				case MalachiteCore::OpCode::OP_JMP_IGE:
+				case MalachiteCore::OpCode::OP_JMP_ILE:
+					useless = true;		//OP_JMP_D* stay: they can report NaN
+					break;
+				default:
+					break;
+				}
+			}
+			if (useless)
+			{
+				removed[i] = true;
+				changed = true;
+			}
+		}
+		return changed;
+	}
+
+	std::vector<MalachiteCore::VMCommand> ByteOptimizer::Compact(const std::vector<MalachiteCore::VMCommand>& commands, const std::vector<bool>& removed, std::vector<uint64_t>& step_map)
+	{
+		//Removed command is mapped to the next kept one
+		step_map.assign(commands.size() + 1, 0);
+		uint64_t kept = 0;
+		for (size_t i = 0; i < commands.size(); i++)
+		{
+			step_map[i] = kept;
+			if (!removed[i]) kept++;
+		}
+		step_map[commands.size()] = kept;
+
+		std::vector<MalachiteCore::VMCommand> result;
+		result.reserve(kept);
+		for (size_t i = 0; i < commands.size(); i++)
+		{
+			if (removed[i]) continue;
+			auto command = commands[i];
+			if (MalachiteCore::GetOperandRoles(command.operation).destination == MalachiteCore::ROLE_TARGET && command.destination <= commands.size())
+			{
+				command.destination = step_map[command.destination];
+			}
+			result.push_back(command);
+		}
+		return result;
+	}
+
+	std::vector<MalachiteCore::VMCommand> ByteOptimizer::Optimize(const std::vector<MalachiteCore::VMCommand>& commands)
+	{
+		ip_map.resize(commands.size() + 1);
+		for (size_t i = 0; i < ip_map.size(); i++) ip_map[i] = i;
+		if (!options.enabled) return commands;
+
+		std::vector<MalachiteCore::VMCommand> result = commands;
+		for (size_t iteration = 0; iteration < options.max_iterations; iteration++)
+		{
+			std::vector<bool> removed(result.size(), false);
+			auto jump_targets = FindJumpTargets(result);
+			bool changed = false;
+			if (options.forward_stores) changed |= ForwardStores(result, removed, jump_targets);
+			if (options.collapse_moves) changed |= CollapseMoves(result, removed, jump_targets);
+			changed |= MarkUseless(result, removed);
+			if (!changed) break;
+
+			std::vector<uint64_t> step_map;
+			result = Compact(result, removed, step_map);
+			for (auto& ip : ip_map) ip = step_map[ip];
+		}
+		return result;
+	}
+}
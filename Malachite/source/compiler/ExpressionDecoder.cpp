@@ -114,8 +114,7 @@ namespace Malachite
 		for (size_t i = 2; i < postfix.size(); i++)
 		{
 			TokensGroup tg = postfix[i];
-			std::vector<TokensGroup> tgv = {tg};	//<- костыль!!!
-			auto commands = PTP_HandleExpression(tgv, es);
+			auto commands = PTP_HandleExpression(tg.tokens, es);	//Argument's group keeps its postfix form
 			result.insert(result.end(), commands.begin(), commands.end()); //x*x = LOAD LOAD MUL
 			result.push_back(PseudoCommand(PseudoOpCode::Push));	//Command without args -> stack principle 
 			//x*x = LOAD LOAD MUL PUSH
@@ -280,7 +279,7 @@ namespace Malachite
 
 		// Добавляем переменную в таблицу
 		Variable var(name_token.value.strVal, type->type_id, is_const);
-		es.state->AddVariableToSpace(es.state->GetCurrentSpace()->vfid,var);
+		es.state->AddVariableToCurrentSpace(var);
 
 		// Генерируем команду объявления
 		PseudoCommand declare_cmd(PseudoOpCode::DeclareVariable);
@@ -377,12 +376,29 @@ namespace Malachite
 
 		return result;
 	}
+	std::vector<PseudoCommand> ExpressionDecoder::DecodeReturnExpression(const std::vector<Token>& tokens, ExpressionState& es)
+	{
+		std::vector<PseudoCommand> result;
+		std::vector<Token> value;
+		for (size_t i = 1; i < tokens.size() && tokens[i].type != TokenType::COMPILATION_LABEL; i++) value.push_back(tokens[i]);
+		if (!value.empty())
+		{
+			result = ProcessRightSide(value, es);
+		}
+		//ByteDecoder checks value with function's return type
+		result.push_back(PseudoCommand(PseudoOpCode::Return, { {PseudoCodeInfo::Get().valueID_name, (uint64_t)!value.empty()} }));
+		return result;
+	}
 	std::vector<PseudoCommand> ExpressionDecoder::DecodeExpression(const std::vector<Token>& tokens, std::shared_ptr<CompilationState> state)
 	{
 		std::vector<PseudoCommand> result;
 		ExpressionState es;
 		es.state = state;
 		
+		if (!tokens.empty() && tokens[0].type == TokenType::KEYWORD && tokens[0].value.strVal == SyntaxInfoKeywords::Get().keyword_return)
+		{
+			return DecodeReturnExpression(tokens, es);
+		}
 		std::vector<Token> temp_tokens;
 		for (size_t i = 0; i < tokens.size(); i++)
 		{
@@ -11,6 +11,7 @@ namespace Malachite
 	std::pair<std::shared_ptr<CompilationState>, std::vector<PseudoCommand>> PseudoByteDecoder::GeneratePseudoCode(const std::vector<ASTNode>& node)
 	{
 		auto compilation_state = std::make_shared<CompilationState>();
+		if (host_registry) compilation_state->AddHostFunctions(*host_registry);
 		std::vector<PseudoCommand> result;
 		result.push_back(PseudoCommand(PseudoOpCode::OpenVisibleScope));
 		for (auto& n : node) 
@@ -56,6 +57,13 @@ namespace Malachite
 		{
 			result = ex_decoder.DecodeExpression(node,state);
 		}
+		//Commands of children have their lines already, the rest is the node's statement.
+		//First token gives the line: ASTNode::line is the line of statement's end token, it can be the next one
+		int line = node.tokens.empty() ? node.line : node.tokens.front().line;
+		for (auto& command : result)
+		{
+			if (command.line == 0 && line > 0) command.line = line;
+		}
 		return result;
 	}
 
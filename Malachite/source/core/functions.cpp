@@ -1,71 +1,803 @@
 #include "../../include/core/functions.h"
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <initializer_list>
+#include <utility>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#elif defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+//Threaded dispatch uses "labels as values" (GCC, Clang). Another compilers use the switch fallback
+#ifndef MALACHITE_COMPUTED_GOTO
+#if defined(__GNUC__) || defined(__clang__)
+#define MALACHITE_COMPUTED_GOTO 1
+#else
+#define MALACHITE_COMPUTED_GOTO 0
+#endif
+#endif
+
+#if MALACHITE_COMPUTED_GOTO
+#define VM_LABEL(op) std::pair<OpCode, const void*>(op, &&L_##op)
+#define VM_CASE(op) L_##op:
+#define VM_DEFAULT L_INVALID:
+#define VM_DISPATCH() { VM_STEP_CHECK(); if (ip >= commands_size) goto vm_end; command = commands + ip; VM_INSTRUMENT(); goto *(!Policy::checked || command->operation < OperationListBlock::OPCODE_TABLE_SIZE ? VM_DISPATCH_TARGET(command->operation) : &&L_INVALID); }
+//Sample policy dispatches by VMSamples::dispatch (VMSampler sets its entries to L_SAMPLE), another loops by the static table
+#define VM_DISPATCH_TARGET(op) (Policy::sample ? sample_dispatch[op].load(std::memory_order_relaxed) : dispatch_table[op])
+#define VM_SAMPLE_POLL()
+#else
+#define VM_CASE(op) case op:
+#define VM_DEFAULT default:
+#define VM_DISPATCH() continue
+//Sample policy without dispatch table: VMSampler request is polled on backward jumps and calls, the sample is taken
+//a random count of commands later, so samples dont gather on the polling commands. Armed loop lowers the end check bound to count them
+#define VM_SAMPLE_POLL() if (Policy::sample && sample_skip == 0 && samples->request.load(std::memory_order_relaxed)) { \
+	samples->request.store(false, std::memory_order_relaxed); \
+	sample_skip = samples->next_skip(); \
+	sample_bound = 0; }
+#endif
+//Single step mode (execute_step) leaves the loop before the second command, Step is a template constant
+#define VM_STEP_CHECK() if (Step && command != nullptr) goto vm_end
+//Profile, sample and trace policies, disabled ones leave nothing in the loop
+#define VM_INSTRUMENT() \
+	if (Policy::profile) profiler.count(command->operation, ip); \
+	if (Policy::trace) { VM_SAVE_STATE(); state->flags = flags; trace(trace_data, state, *command); }
+//Budget policy (execute_slice): budget is charged on backward jumps (by the length of the jumped over code) and calls, state stops at target.
+//Budget 0 is unlimited (UINT64_MAX local), the policy then serves only stop_request
+#define VM_PREEMPT(target, cost) if (Policy::budget) { \
+	uint64_t charge = (cost); \
+	if (charge >= budget || (stop_request != nullptr && stop_request->load(std::memory_order_relaxed))) { ip = (target); goto vm_yield; } \
+	budget -= charge; }
+#define VM_NEXT() { ip++; VM_DISPATCH(); }
+#define VM_JUMP(target) { uint64_t jump_target = (target); if (jump_target <= ip) { VM_PREEMPT(jump_target, ip - jump_target + 1); VM_SAMPLE_POLL(); } ip = jump_target; VM_DISPATCH(); }
+#define VM_ERROR(error) { result = (error); goto vm_error; }
+//Checks that verify_program proves are compiled out of the unchecked loop (Policy::checked = false)
+#define VM_CHECK(condition, error) if (Policy::checked && (condition)) VM_ERROR(error)
+//Hot locals -> VMState, when execution leaves the loop
+#define VM_SAVE_STATE() { state->ip = ip; state->sp = sp; state->fp = fp; state->heap_high_water = heap_high; state->stack_low_water = stack_low; }
+
+//Memory command bodies, shared by generic (size from operand) and width-specialized (constant size) commands
+#define VM_CHECK_SIZE(SIZE) VM_CHECK((SIZE) == 0 || (SIZE) > REGISTER_SIZE, VMError::MEMORY_ACCESS_VIOLATION);
+//Written ranges for VMState::reset: heap grows up to heap_high, stack down to stack_low
+#define VM_MARK_STACK(ADDRESS) if ((ADDRESS) < stack_low) stack_low = (ADDRESS);
+#define VM_MARK_DIRTY(ADDRESS, SIZE) if ((ADDRESS) <= heap_end) { if ((ADDRESS) + (SIZE) > heap_high) heap_high = (ADDRESS) + (SIZE); } else VM_MARK_STACK(ADDRESS)
+#define VM_LOAD_RM(SIZE, LOAD, STORE) { \
+	VM_CHECK_SIZE(SIZE) \
+	VM_CHECK(command->source0 > memory_size - (SIZE), VMError::MEMORY_ACCESS_VIOLATION); \
+	registers[command->destination].u = LOAD(memory + command->source0, SIZE); \
+	VM_NEXT(); }
+#define VM_STORE_MR(SIZE, LOAD, STORE) { \
+	VM_CHECK_SIZE(SIZE) \
+	VM_CHECK(command->destination > memory_size - (SIZE), VMError::MEMORY_ACCESS_VIOLATION); \
+	VM_MARK_DIRTY(command->destination, SIZE) \
+	STORE(memory + command->destination, registers[command->source0].u, SIZE); \
+	VM_NEXT(); }
+#define VM_PUSH(SIZE, LOAD, STORE) { \
+	VM_CHECK_SIZE(SIZE) \
+	VM_CHECK(sp < stack_end + (SIZE), VMError::STACK_OVERFLOW); \
+	sp -= (SIZE); \
+	VM_MARK_STACK(sp) \
+	STORE(memory + sp, registers[command->source0].u, SIZE); \
+	VM_NEXT(); }
+#define VM_POP(SIZE, LOAD, STORE) { \
+	VM_CHECK_SIZE(SIZE) \
+	VM_CHECK(sp + (SIZE) > memory_size, VMError::STACK_UNDERFLOW); \
+	registers[command->destination].u = LOAD(memory + sp, SIZE); \
+	sp += (SIZE); \
+	VM_NEXT(); }
+//Slot below BASE: fp for locals, stack start for resolved ones (*_STACK)
+#define VM_LOAD_SLOT(SIZE, LOAD, STORE, BASE) { \
+	VM_CHECK_SIZE(SIZE) \
+	uint64_t start_position; \
+	if (!frame_slot<Policy::checked>(stack_bounds, BASE, command->source0, SIZE, start_position)) VM_ERROR(VMError::MEMORY_ACCESS_VIOLATION); \
+	registers[command->destination].u = LOAD(memory + start_position, SIZE); \
+	VM_NEXT(); }
+#define VM_STORE_SLOT(SIZE, LOAD, STORE, BASE) { \
+	VM_CHECK_SIZE(SIZE) \
+	uint64_t start_position; \
+	if (!frame_slot<Policy::checked>(stack_bounds, BASE, command->destination, SIZE, start_position)) VM_ERROR(VMError::MEMORY_ACCESS_VIOLATION); \
+	VM_MARK_STACK(start_position) \
+	STORE(memory + start_position, registers[command->source0].u, SIZE); \
+	VM_NEXT(); }
+#define VM_LOAD_LOCAL(SIZE, LOAD, STORE) VM_LOAD_SLOT(SIZE, LOAD, STORE, fp)
+#define VM_STORE_LOCAL(SIZE, LOAD, STORE) VM_STORE_SLOT(SIZE, LOAD, STORE, fp)
+#define VM_LOAD_STACK(SIZE, LOAD, STORE) VM_LOAD_SLOT(SIZE, LOAD, STORE, stack_bounds.start)
+#define VM_STORE_STACK(SIZE, LOAD, STORE) VM_STORE_SLOT(SIZE, LOAD, STORE, stack_bounds.start)
+//A - depth from the first frame, R - depth from the current frame
+#define VM_FRAME_FROM_START(depth) state->data_stack.at_unchecked(depth).fp
+#define VM_FRAME_FROM_TOP(depth) state->data_stack.at_unchecked(state->data_stack.size() - 1 - (depth)).fp
+#define VM_STORE_ENCLOSING(SIZE, LOAD, STORE, FRAME) { \
+	VM_CHECK_SIZE(SIZE) \
+	uint64_t depth = command->source1 & PACKED_DEPTH_MASK; \
+	VM_CHECK(depth >= state->data_stack.size(), VMError::STACK_UNDERFLOW); \
+	uint64_t start_position; \
+	if (!frame_slot<Policy::checked>(stack_bounds, FRAME(depth), command->destination, SIZE, start_position)) VM_ERROR(VMError::MEMORY_ACCESS_VIOLATION); \
+	VM_MARK_STACK(start_position) \
+	STORE(memory + start_position, registers[command->source0].u, SIZE); \
+	VM_NEXT(); }
+#define VM_LOAD_ENCLOSING(SIZE, LOAD, STORE, FRAME) { \
+	VM_CHECK_SIZE(SIZE) \
+	uint64_t depth = command->source1 & PACKED_DEPTH_MASK; \
+	VM_CHECK(depth >= state->data_stack.size(), VMError::STACK_UNDERFLOW); \
+	uint64_t start_position; \
+	if (!frame_slot<Policy::checked>(stack_bounds, FRAME(depth), command->source0, SIZE, start_position)) VM_ERROR(VMError::MEMORY_ACCESS_VIOLATION); \
+	registers[command->destination].u = LOAD(memory + start_position, SIZE); \
+	VM_NEXT(); }
+#define VM_STORE_ENCLOSING_A(SIZE, LOAD, STORE) VM_STORE_ENCLOSING(SIZE, LOAD, STORE, VM_FRAME_FROM_START)
+#define VM_LOAD_ENCLOSING_A(SIZE, LOAD, STORE) VM_LOAD_ENCLOSING(SIZE, LOAD, STORE, VM_FRAME_FROM_START)
+#define VM_STORE_ENCLOSING_R(SIZE, LOAD, STORE) VM_STORE_ENCLOSING(SIZE, LOAD, STORE, VM_FRAME_FROM_TOP)
+#define VM_LOAD_ENCLOSING_R(SIZE, LOAD, STORE) VM_LOAD_ENCLOSING(SIZE, LOAD, STORE, VM_FRAME_FROM_TOP)
+
+#define VM_WIDTH_CASES(op, BODY) \
+	VM_CASE(op##_U8) BODY(1, load_width<uint8_t>, store_width<uint8_t>) \
+	VM_CASE(op##_U16) BODY(2, load_width<uint16_t>, store_width<uint16_t>) \
+	VM_CASE(op##_U32) BODY(4, load_width<uint32_t>, store_width<uint32_t>) \
+	VM_CASE(op##_U64) BODY(8, load_width<uint64_t>, store_width<uint64_t>)
+#define VM_WIDTH_LABELS(op) VM_LABEL(op##_U8), VM_LABEL(op##_U16), VM_LABEL(op##_U32), VM_LABEL(op##_U64)
+
+//Fused compare and jump
+#define VM_INT_JUMP_IF(compare) { \
+	if (registers[command->source0].i compare registers[command->source1].i) VM_JUMP(command->destination); \
+	VM_NEXT(); }
+#define VM_DOUBLE_JUMP_IF(compare) { \
+	double first = registers[command->source0].d; \
+	double second = registers[command->source1].d; \
+	if (std::isnan(first) || std::isnan(second)) VM_ERROR(VMError::NAN_FLOAT_VALUE); \
+	if (first compare second) VM_JUMP(command->destination); \
+	VM_NEXT(); }
 
 namespace MalachiteCore 
 {
+	namespace
+	{
+		static_assert(std::endian::native == std::endian::little, "VM memory is little-endian, loads and stores below copy bytes as is");
+
+		inline uint64_t load_bytes(const uint8_t* source, uint64_t size)
+		{
+			uint64_t value = 0;
+			memcpy(&value, source, size);
+			return value;
+		}
+		inline void store_bytes(uint8_t* destination, uint64_t value, uint64_t size)
+		{
+			memcpy(destination, &value, size);
+		}
+		template<typename T>
+		inline uint64_t load_width(const uint8_t* source, uint64_t)
+		{
+			T value;
+			memcpy(&value, source, sizeof(T));
+			return value;
+		}
+		template<typename T>
+		inline void store_width(uint8_t* destination, uint64_t value, uint64_t)
+		{
+			T narrow = static_cast<T>(value);
+			memcpy(destination, &narrow, sizeof(T));
+		}
+
+		struct StackBounds
+		{
+			uint64_t start;		//Top of memory
+			uint64_t end;		//Last stack byte
+		};
+
+		//Start of variable with offset and size in the frame (variables grow down from frame pointer)
+		template<bool Checked>
+		inline bool frame_slot(const StackBounds& stack, uint64_t frame_fp, uint64_t offset, uint64_t size, uint64_t& start_position)
+		{
+			if (!Checked)
+			{
+				start_position = frame_fp - offset - size + 1;
+				return true;
+			}
+			if (offset > frame_fp || frame_fp - offset < stack.end) return false;
+			uint64_t address = frame_fp - offset;
+			if (address > stack.start || address - size < stack.end) return false;
+			start_position = address - size + 1;
+			return true;
+		}
+	}
+
+	namespace
+	{
+		//Verifier assumed a fresh start: ip 0, empty frame and call stacks, sizes not smaller than the program needs.
+		//Resumed runs (after HALT or YIELD) keep the checks
+		inline bool can_run_unchecked(const VMState* state, const VMProgram* program)
+		{
+			if (state == nullptr || program == nullptr || !program->verification.verified) return false;
+			if (state->flags & FLAG::STOPPED_FLAG) return false;
+			if (state->memory == nullptr || state->memory_size < program->verification.memory_size) return false;
+			if (state->stack_start - state->stack_end + 1 < program->verification.stack_size) return false;
+			if (program->verification.host_functions > 0 && (state->hosts == nullptr || state->hosts->size() < program->verification.host_functions)) return false;
+			return state->sp == state->stack_start && state->fp == state->stack_start && state->data_stack.empty() && state->call_stack.empty();
+		}
+
+		inline uint64_t timestamp()
+		{
+#if (defined(_MSC_VER) && defined(_M_X64)) || defined(__x86_64__)
+			return __rdtsc();
+#else
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+		}
+
+#if MALACHITE_COMPUTED_GOTO
+		//Sample policy: dispatch table of the loop is in VMSamples while the loop runs
+		struct SampleScope
+		{
+			VMSamples* samples = nullptr;
+
+			SampleScope(VMSamples* samples, const void* const* table, const void* sample_target) : samples(samples)
+			{
+				if (samples != nullptr) samples->enter(table, sample_target);
+			}
+			~SampleScope()
+			{
+				if (samples != nullptr) samples->leave();
+			}
+		};
+#endif
+
+		//Counters of the profile policy. Timed command takes ticks from its dispatch to the next one, run time is added on exit from the loop
+		struct Profiler
+		{
+			uint64_t* commands = nullptr;
+			uint64_t* ips = nullptr;
+			VMStats* stats = nullptr;
+			uint32_t period = 0;
+			uint32_t countdown = 0;
+			size_t timed_class = OPERATION_CLASS_COUNT;		//Class of the command being timed, OPERATION_CLASS_COUNT - none
+			uint64_t timed_start = 0;
+			std::chrono::steady_clock::time_point start{};
+
+			Profiler(VMState* state, const ExecutionOptions& options, size_t commands_size, bool enabled)
+			{
+				if (!enabled) return;
+				stats = state->stats;
+				if (options.profile != nullptr) commands = options.profile->commands;
+				else if (stats != nullptr) commands = stats->profile.commands;
+				if (stats == nullptr) return;
+				if (stats->ips.size() < commands_size) stats->ips.resize(commands_size);
+				ips = stats->ips.data();
+				period = countdown = stats->timing_period;
+				start = std::chrono::steady_clock::now();
+			}
+			~Profiler()
+			{
+				if (stats == nullptr) return;
+				stats->runs++;
+				stats->run_time += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+			}
+
+			inline void count(OpCode operation, uint64_t ip)
+			{
+				if (commands != nullptr && operation < OperationListBlock::OPCODE_TABLE_SIZE) commands[operation]++;
+				if (ips == nullptr) return;
+				ips[ip]++;
+				if (period == 0) return;
+				if (timed_class != OPERATION_CLASS_COUNT)
+				{
+					stats->class_time[timed_class] += timestamp() - timed_start;
+					stats->class_timed[timed_class]++;
+					timed_class = OPERATION_CLASS_COUNT;
+				}
+				if (--countdown == 0)
+				{
+					countdown = period;
+					timed_class = static_cast<size_t>(get_operation_class(operation));
+					timed_start = timestamp();
+				}
+			}
+		};
+	}
+
+	//Main loop of all execute variants, Step - execute_step
+	template<typename Policy, bool Step = false>
+	static VMError run(VMState* state, const VMProgram* program, const ExecutionOptions& options);
+
+	namespace
+	{
+		using RunFunction = VMError(*)(VMState*, const VMProgram*, const ExecutionOptions&);
+
+		//Index bits: 1 - unchecked, 2 - profile, 4 - trace, 8 - budget, 16 - sample
+		template<size_t Index>
+		using IndexPolicy = ExecutionPolicy<(Index & 1) == 0, (Index & 2) != 0, (Index & 4) != 0, (Index & 8) != 0, (Index & 16) != 0>;
+
+		template<size_t... Indices>
+		constexpr std::array<RunFunction, sizeof...(Indices)> make_run_table(std::index_sequence<Indices...>)
+		{
+			return { &run<IndexPolicy<Indices>>... };
+		}
+
+		//The loop is selected once per call
+		VMError select_run(VMState* state, const VMProgram* program, const ExecutionOptions& options, bool budget)
+		{
+			static constexpr auto runs = make_run_table(std::make_index_sequence<32>());
+			size_t index = (can_run_unchecked(state, program) ? 1 : 0) | (options.profile != nullptr || (state != nullptr && state->stats != nullptr) ? 2 : 0) | (options.trace != nullptr ? 4 : 0) | (budget ? 8 : 0)
+				| (state != nullptr && state->samples != nullptr ? 16 : 0);
+			return runs[index](state, program, options);
+		}
+	}
+
+#if MALACHITE_COMPUTED_GOTO
+	namespace
+	{
+		using DispatchTable = std::array<const void*, OperationListBlock::OPCODE_TABLE_SIZE>;
+
+		//One entry per OpCode, operations without entry go to the invalid label
+		DispatchTable make_dispatch_table(std::initializer_list<std::pair<OpCode, const void*>> entries, const void* invalid)
+		{
+			DispatchTable table;
+			table.fill(invalid);
+			for (auto& entry : entries) table[entry.first] = entry.second;
+			return table;
+		}
+	}
+#endif
+
 	VMError execute(VMState* state, VMCommand* commands, size_t commands_size)
 	{
 		if (state == nullptr)return VMError::VMS_PTR_INVALID;
-		if (commands == nullptr) return VMError::VMCS_INVALID;
-		if (commands_size == 0) return VMError::VMCS_INVALID;
+		VMProgram program;
+		VMError result = encode_program(commands, commands_size, program);
+		if (result != VMError::NO_ERROR) return result;
+		return execute(state, &program);
+	}
+
+	VMError execute(VMState* state, const VMProgram* program)
+	{
+		return select_run(state, program, ExecutionOptions(), false);
+	}
+
+	VMError execute(VMState* state, const VMProgram* program, const ExecutionOptions& options)
+	{
+		return select_run(state, program, options, options.budget != 0 || options.stop_request != nullptr);
+	}
 
-		if (!(state->flags & FLAG::STOPPED_FLAG))state->ip = 0;
+	template<typename Policy>
+	VMError execute(VMState* state, const VMProgram* program, const ExecutionOptions& options)
+	{
+		if (!Policy::checked && !can_run_unchecked(state, program)) return VMError::VMCS_INVALID;
+		if (Policy::profile && options.profile == nullptr && (state == nullptr || state->stats == nullptr)) return VMError::VMCS_INVALID;
+		if (Policy::trace && options.trace == nullptr) return VMError::VMCS_INVALID;
+		if (Policy::sample && (state == nullptr || state->samples == nullptr)) return VMError::VMCS_INVALID;
+		return run<Policy>(state, program, options);
+	}
+
+	VMError execute_step(VMState* state, const VMProgram* program)
+	{
+		return run<DefaultPolicy, true>(state, program, ExecutionOptions());
+	}
+
+	VMError execute_slice(VMState* state, const VMProgram* program, uint64_t budget, const std::atomic<bool>* stop_request)
+	{
+		ExecutionOptions options;
+		options.budget = budget;
+		options.stop_request = stop_request;
+		return select_run(state, program, options, true);
+	}
+
+	template<typename Policy, bool Step>
+	VMError run(VMState* state, const VMProgram* program, const ExecutionOptions& options)
+	{
+		if (state == nullptr || state->memory == nullptr)return VMError::VMS_PTR_INVALID;
+		if (program == nullptr || program->code.empty()) return VMError::VMCS_INVALID;
+
+		const PackedCommand* commands = program->code.data();
+		const size_t commands_size = program->code.size();
+		const Register* constants = program->constants.data();
+		const size_t constants_size = program->constants.size();
+		const HostEntry* hosts = state->hosts != nullptr ? state->hosts->entries() : nullptr;
+		const size_t hosts_size = state->hosts != nullptr ? state->hosts->size() : 0;
+
+		if (Step) {}	//Step continues from state->ip as is
+		else if (!(state->flags & FLAG::STOPPED_FLAG))state->ip = 0;
 		else state->flags &= ~FLAG::STOPPED_FLAG;
-		size_t command_size = sizeof(VMCommand);
 
+		//Hot state is kept in locals and written back to VMState when execution leaves the loop
+		Register* registers = state->registers;
+		uint8_t* memory = state->memory;
+		const uint64_t memory_size = state->memory_size;
+		const uint64_t stack_end = state->stack_end;
+		const StackBounds stack_bounds{ state->stack_start, state->stack_end };
+		const uint64_t heap_end = state->heap_end;
+		uint64_t heap_high = state->heap_high_water;
+		uint64_t stack_low = state->stack_low_water;
+		uint64_t ip = state->ip;
+		uint64_t sp = state->sp;
+		uint64_t fp = state->fp;
+		uint32_t flags = state->flags;
+		const PackedCommand* command = nullptr;
 		VMError result = VMError::NO_ERROR;
+		//Policy state, unused by disabled policies
+		[[maybe_unused]] uint64_t budget = options.budget != 0 ? options.budget : UINT64_MAX;	//0 - unlimited, only stop_request ends the run
+		[[maybe_unused]] const std::atomic<bool>* stop_request = options.stop_request;
+		[[maybe_unused]] Profiler profiler(state, options, commands_size, Policy::profile);
+		[[maybe_unused]] TraceCallback trace = options.trace;
+		[[maybe_unused]] void* trace_data = options.trace_data;
+		[[maybe_unused]] VMSamples* samples = state->samples;
+		[[maybe_unused]] uint32_t sample_skip = 0;		//Switch loop: commands before the requested sample, 0 - isnt requested
+		[[maybe_unused]] uint64_t sample_bound = commands_size;		//Switch loop: 0 while sample_skip is counted
+		if (Policy::sample) samples->request.store(false, std::memory_order_relaxed);	//Request made between runs is dropped
 
-		while (state->ip < commands_size) 
-		{
-			state->flags &= ~FLAG::JUMPED_FLAG;
-			VMCommand* command = commands + state->ip;
+#if MALACHITE_COMPUTED_GOTO
+		static const DispatchTable dispatch_table = make_dispatch_table({
+			VM_LABEL(OP_NOP),
+			// Arithmetic
+			VM_LABEL(OP_IADD_RRR), VM_LABEL(OP_ISUB_RRR), VM_LABEL(OP_IMUL_RRR), VM_LABEL(OP_IDIV_RRR), VM_LABEL(OP_IMOD_RRR), VM_LABEL(OP_INEG_RR),
+			VM_LABEL(OP_UADD_RRR), VM_LABEL(OP_USUB_RRR), VM_LABEL(OP_UMUL_RRR), VM_LABEL(OP_UDIV_RRR), VM_LABEL(OP_UMOD_RRR),
+			VM_LABEL(OP_DADD_RRR), VM_LABEL(OP_DSUB_RRR), VM_LABEL(OP_DMUL_RRR), VM_LABEL(OP_DDIV_RRR), VM_LABEL(OP_DNEG_RR),
+			// Logic
+			VM_LABEL(OP_AND_RRR), VM_LABEL(OP_OR_RRR), VM_LABEL(OP_NOT_RR), VM_LABEL(OP_BIT_OR_RRR), VM_LABEL(OP_BIT_NOT_RR), VM_LABEL(OP_BIT_AND_RRR),
+			VM_LABEL(OP_BIT_OFFSET_LEFT_RRR), VM_LABEL(OP_BIT_OFFSET_RIGHT_RRR), VM_LABEL(OP_CMP_RR), VM_LABEL(OP_DCMP_RR), VM_LABEL(OP_GET_FLAG),
+			// Memory
+			VM_LABEL(OP_LOAD_RM), VM_LABEL(OP_STORE_MR), VM_LABEL(OP_MOV_RR), VM_LABEL(OP_MOV_RI_INT), VM_LABEL(OP_MOV_RI_UINT), VM_LABEL(OP_MOV_RC),
+			VM_LABEL(OP_CREATE_FRAME), VM_LABEL(OP_DESTROY_FRAME), VM_LABEL(OP_DESTROY_FRAMES), VM_LABEL(OP_PUSH), VM_LABEL(OP_POP),
+			VM_LABEL(OP_LOAD_LOCAL), VM_LABEL(OP_STORE_LOCAL), VM_LABEL(OP_LOAD_STACK), VM_LABEL(OP_STORE_STACK),
+			VM_LABEL(OP_STORE_ENCLOSING_A), VM_LABEL(OP_LOAD_ENCLOSING_A), VM_LABEL(OP_STORE_ENCLOSING_R), VM_LABEL(OP_LOAD_ENCLOSING_R),
+			VM_LABEL(OP_ALLOCATE_MEMORY), VM_LABEL(OP_FREE_MEMORY),
+			// Width-specialized memory
+			VM_WIDTH_LABELS(OP_LOAD_RM), VM_WIDTH_LABELS(OP_STORE_MR), VM_WIDTH_LABELS(OP_PUSH), VM_WIDTH_LABELS(OP_POP),
+			VM_WIDTH_LABELS(OP_LOAD_LOCAL), VM_WIDTH_LABELS(OP_STORE_LOCAL),
+			VM_WIDTH_LABELS(OP_STORE_ENCLOSING_A), VM_WIDTH_LABELS(OP_LOAD_ENCLOSING_A), VM_WIDTH_LABELS(OP_STORE_ENCLOSING_R), VM_WIDTH_LABELS(OP_LOAD_ENCLOSING_R),
+			VM_WIDTH_LABELS(OP_LOAD_STACK), VM_WIDTH_LABELS(OP_STORE_STACK),
+			// Control flow
+			VM_LABEL(OP_JMP), VM_LABEL(OP_JMP_CV), VM_LABEL(OP_JMP_CNV), VM_LABEL(OP_CALL), VM_LABEL(OP_RET), VM_LABEL(OP_HALT),
+			VM_LABEL(OP_JMP_IEQ), VM_LABEL(OP_JMP_INE), VM_LABEL(OP_JMP_IGT), VM_LABEL(OP_JMP_ILT), VM_LABEL(OP_JMP_IGE), VM_LABEL(OP_JMP_ILE),
+			VM_LABEL(OP_JMP_DEQ), VM_LABEL(OP_JMP_DNE), VM_LABEL(OP_JMP_DGT), VM_LABEL(OP_JMP_DLT), VM_LABEL(OP_JMP_DGE), VM_LABEL(OP_JMP_DLE),
+			VM_LABEL(OP_CALL_HOST),
+			// System calls and types convertion
+			VM_LABEL(OP_SYSTEM_CALL),
+			VM_LABEL(OP_TC_ITD_R), VM_LABEL(OP_TC_DTI_R), VM_LABEL(OP_TC_UITD_R), VM_LABEL(OP_TC_UITI_R), VM_LABEL(OP_TC_DTUI_R), VM_LABEL(OP_TC_ITUI_R),
+		}, &&L_INVALID);
+		[[maybe_unused]] SampleScope sample_scope(Policy::sample ? samples : nullptr, dispatch_table.data(), &&L_SAMPLE);
+		[[maybe_unused]] std::atomic<const void*>* sample_dispatch = Policy::sample ? samples->dispatch : nullptr;
 
-			if (command->operation == OpCode::OP_NOP)
+		VM_DISPATCH();
+		{
+#else
+		for (;;)
+		{
+			VM_STEP_CHECK();
+			if (ip >= (Policy::sample ? sample_bound : commands_size))
 			{
-				state->ip++;
-				continue;
+				if (ip >= commands_size) goto vm_end;
+				if (Policy::sample && --sample_skip == 0)
+				{
+					sample_bound = commands_size;
+					samples->take(state, ip);
+				}
 			}
+			command = commands + ip;
+			VM_INSTRUMENT();
+			switch (command->operation)
+			{
+#endif
+			VM_CASE(OP_NOP)
+				VM_NEXT();
 
-			if (OperationListBlock::IsOperationInInterval(command->operation, OperationListBlock::ARITHMETIC_START, OperationListBlock::ARITHMETIC_END))
+			// Arithmetic------------------------------
+			VM_CASE(OP_IADD_RRR)
+				registers[command->destination].i = registers[command->source0].i + registers[command->source1].i;
+				VM_NEXT();
+			VM_CASE(OP_ISUB_RRR)
+				registers[command->destination].i = registers[command->source0].i - registers[command->source1].i;
+				VM_NEXT();
+			VM_CASE(OP_IMUL_RRR)
+				registers[command->destination].i = registers[command->source0].i * registers[command->source1].i;
+				VM_NEXT();
+			VM_CASE(OP_IDIV_RRR)
+				if (registers[command->source1].i == 0) VM_ERROR(VMError::ZERO_DIVISION);
+				registers[command->destination].i = registers[command->source0].i / registers[command->source1].i;
+				VM_NEXT();
+			VM_CASE(OP_IMOD_RRR)
+				if (registers[command->source1].i == 0) VM_ERROR(VMError::ZERO_DIVISION);
+				registers[command->destination].i = registers[command->source0].i % registers[command->source1].i;
+				VM_NEXT();
+			VM_CASE(OP_INEG_RR)
+				registers[command->destination].i = -registers[command->source0].i;
+				VM_NEXT();
+			VM_CASE(OP_UADD_RRR)
+				registers[command->destination].u = registers[command->source0].u + registers[command->source1].u;
+				VM_NEXT();
+			VM_CASE(OP_USUB_RRR)
+				registers[command->destination].u = registers[command->source0].u - registers[command->source1].u;
+				VM_NEXT();
+			VM_CASE(OP_UMUL_RRR)
+				registers[command->destination].u = registers[command->source0].u * registers[command->source1].u;
+				VM_NEXT();
+			VM_CASE(OP_UDIV_RRR)
+				if (registers[command->source1].u == 0) VM_ERROR(VMError::ZERO_DIVISION);
+				registers[command->destination].u = registers[command->source0].u / registers[command->source1].u;
+				VM_NEXT();
+			VM_CASE(OP_UMOD_RRR)
+				if (registers[command->source1].u == 0) VM_ERROR(VMError::ZERO_DIVISION);
+				registers[command->destination].u = registers[command->source0].u % registers[command->source1].u;
+				VM_NEXT();
+			VM_CASE(OP_DADD_RRR)
+				registers[command->destination].d = registers[command->source0].d + registers[command->source1].d;
+				VM_NEXT();
+			VM_CASE(OP_DSUB_RRR)
+				registers[command->destination].d = registers[command->source0].d - registers[command->source1].d;
+				VM_NEXT();
+			VM_CASE(OP_DMUL_RRR)
+				registers[command->destination].d = registers[command->source0].d * registers[command->source1].d;
+				VM_NEXT();
+			VM_CASE(OP_DDIV_RRR)
+				if (registers[command->source1].d == 0) VM_ERROR(VMError::ZERO_DIVISION);
+				registers[command->destination].d = registers[command->source0].d / registers[command->source1].d;
+				VM_NEXT();
+			VM_CASE(OP_DNEG_RR)
+				registers[command->destination].d = -registers[command->source0].d;
+				VM_NEXT();
+
+			// Logic-----------------------------------
+			VM_CASE(OP_AND_RRR)
+				registers[command->destination].i = registers[command->source0].i != 0 && registers[command->source1].i != 0;
+				VM_NEXT();
+			VM_CASE(OP_OR_RRR)
+				registers[command->destination].i = registers[command->source0].i != 0 || registers[command->source1].i != 0;
+				VM_NEXT();
+			VM_CASE(OP_NOT_RR)
+				registers[command->destination].i = !(registers[command->source0].i != 0);
+				VM_NEXT();
+			VM_CASE(OP_BIT_AND_RRR)
+				registers[command->destination].i = registers[command->source0].i & registers[command->source1].i;
+				VM_NEXT();
+			VM_CASE(OP_BIT_OR_RRR)
+				registers[command->destination].i = registers[command->source0].i | registers[command->source1].i;
+				VM_NEXT();
+			VM_CASE(OP_BIT_NOT_RR)
+				registers[command->destination].i = ~(registers[command->source0].i);
+				VM_NEXT();
+			VM_CASE(OP_BIT_OFFSET_LEFT_RRR)
+				registers[command->destination].i = registers[command->source0].i << registers[command->source1].i;
+				VM_NEXT();
+			VM_CASE(OP_BIT_OFFSET_RIGHT_RRR)
+				registers[command->destination].i = registers[command->source0].i >> registers[command->source1].i;
+				VM_NEXT();
+			VM_CASE(OP_CMP_RR)
 			{
-				result = arithmetic_handler(state, command);
+				int64_t first = registers[command->source0].i;
+				int64_t second = registers[command->source1].i;
+				flags &= ~(FLAG::EQUAL_FLAG | FLAG::NOT_EQUAL_FLAG | FLAG::LESS_FLAG | FLAG::GREATER_FLAG);
+				if (first == second) flags |= FLAG::EQUAL_FLAG;
+				else if (first > second) flags |= FLAG::GREATER_FLAG | FLAG::NOT_EQUAL_FLAG;
+				else flags |= FLAG::LESS_FLAG | FLAG::NOT_EQUAL_FLAG;
+				VM_NEXT();
 			}
-			else if (OperationListBlock::IsOperationInInterval(command->operation, OperationListBlock::LOGIC_START, OperationListBlock::LOGIC_END))
+			VM_CASE(OP_DCMP_RR)
 			{
-				result = logic_handler(state, command);
+				double first = registers[command->source0].d;
+				double second = registers[command->source1].d;
+				flags &= ~(FLAG::EQUAL_FLAG | FLAG::NOT_EQUAL_FLAG | FLAG::LESS_FLAG | FLAG::GREATER_FLAG);
+				if (std::isnan(first) || std::isnan(second)) VM_ERROR(VMError::NAN_FLOAT_VALUE);
+				if (first == second) flags |= FLAG::EQUAL_FLAG;
+				else if (first > second) flags |= FLAG::GREATER_FLAG | FLAG::NOT_EQUAL_FLAG;
+				else flags |= FLAG::LESS_FLAG | FLAG::NOT_EQUAL_FLAG;
+				VM_NEXT();
 			}
-			else if (OperationListBlock::IsOperationInInterval(command->operation, OperationListBlock::MEMORY_START, OperationListBlock::MEMORY_END))
+			VM_CASE(OP_GET_FLAG)
+				registers[command->destination].u = flags & (uint32_t)command->source0;
+				VM_NEXT();
+
+			// Memory----------------------------------
+			VM_CASE(OP_LOAD_RM) VM_LOAD_RM(command->source1, load_bytes, store_bytes)
+			VM_CASE(OP_STORE_MR) VM_STORE_MR(command->source1, load_bytes, store_bytes)
+			VM_CASE(OP_MOV_RR)
+				registers[command->destination].i = registers[command->source0].i;
+				VM_NEXT();
+			VM_CASE(OP_MOV_RI_INT)
+				registers[command->destination].i = static_cast<int32_t>(command->source0);
+				VM_NEXT();
+			VM_CASE(OP_MOV_RI_UINT)
+				registers[command->destination].u = command->source0;
+				VM_NEXT();
+			VM_CASE(OP_MOV_RC)
+				VM_CHECK(command->source0 >= constants_size, VMError::MEMORY_ACCESS_VIOLATION);
+				registers[command->destination] = constants[command->source0];
+				VM_NEXT();
+			VM_CASE(OP_CREATE_FRAME)
+				if (state->data_stack.full()) VM_ERROR(VMError::STACK_OVERFLOW);	//Frames of recursive calls pile up: checked by every loop
+				VM_CHECK(sp < stack_end + command->destination, VMError::STACK_OVERFLOW);
+				state->data_stack.push_unchecked(DataFrame{ fp, sp });
+				fp = sp;
+				sp -= command->destination;	//Slots arent written: only stores to them mark the stack dirty
+				VM_NEXT();
+			VM_CASE(OP_DESTROY_FRAME)
 			{
-				result = memory_handler(state, command);
+				VM_CHECK(state->data_stack.empty(), VMError::STACK_UNDERFLOW);
+				DataFrame df = state->data_stack.pop_unchecked();
+				fp = df.fp;
+				sp = df.sp;
+				VM_NEXT();
 			}
-			else if (OperationListBlock::IsOperationInInterval(command->operation, OperationListBlock::CONTROL_FLOW_START, OperationListBlock::CONTROL_FLOW_END))
+			VM_CASE(OP_DESTROY_FRAMES)
 			{
-				result = control_flow_handler(state, command);
+				VM_CHECK(command->destination > state->data_stack.size(), VMError::STACK_UNDERFLOW);
+				if (command->destination == 0) VM_NEXT();
+				//Only the last (the most outer) frame is restored
+				size_t outer = state->data_stack.size() - command->destination;
+				DataFrame last_df = state->data_stack.at_unchecked(outer);
+				state->data_stack.truncate_unchecked(outer);
+				fp = last_df.fp;
+				sp = last_df.sp;
+				VM_NEXT();
 			}
-			else if (OperationListBlock::IsOperationInInterval(command->operation, OperationListBlock::SYSTEM_CALLS_START, OperationListBlock::SYSTEM_CALLS_END))
+			VM_CASE(OP_PUSH) VM_PUSH(command->destination, load_bytes, store_bytes)
+			VM_CASE(OP_POP) VM_POP(command->source0, load_bytes, store_bytes)
+			VM_CASE(OP_LOAD_LOCAL) VM_LOAD_LOCAL(command->source1, load_bytes, store_bytes)
+			VM_CASE(OP_STORE_LOCAL) VM_STORE_LOCAL(command->source1, load_bytes, store_bytes)
+			VM_CASE(OP_LOAD_STACK) VM_LOAD_STACK(command->source1, load_bytes, store_bytes)
+			VM_CASE(OP_STORE_STACK) VM_STORE_STACK(command->source1, load_bytes, store_bytes)
+			VM_CASE(OP_STORE_ENCLOSING_A) VM_STORE_ENCLOSING(command->source1 >> PACKED_SIZE_SHIFT, load_bytes, store_bytes, VM_FRAME_FROM_START)
+			VM_CASE(OP_LOAD_ENCLOSING_A) VM_LOAD_ENCLOSING(command->source1 >> PACKED_SIZE_SHIFT, load_bytes, store_bytes, VM_FRAME_FROM_START)
+			VM_CASE(OP_STORE_ENCLOSING_R) VM_STORE_ENCLOSING(command->source1 >> PACKED_SIZE_SHIFT, load_bytes, store_bytes, VM_FRAME_FROM_TOP)
+			VM_CASE(OP_LOAD_ENCLOSING_R) VM_LOAD_ENCLOSING(command->source1 >> PACKED_SIZE_SHIFT, load_bytes, store_bytes, VM_FRAME_FROM_TOP)
+			VM_CASE(OP_ALLOCATE_MEMORY)
 			{
-				result = syscalls_handler(state, command);
+				uint64_t pointer = state->heap.allocate(registers[command->source0].u);
+				if (pointer == 0) VM_ERROR(VMError::HEAP_OUT_OF_MEMORY);
+				registers[command->destination].u = pointer;
+				state->hp = state->heap.top();
+				VM_NEXT();
 			}
-			else 
+			VM_CASE(OP_FREE_MEMORY)
+				if (!state->heap.free(registers[command->destination].u)) VM_ERROR(VMError::INVALID_HEAP_POINTER);
+				state->hp = state->heap.top();
+				VM_NEXT();
+
+			// Width-specialized memory----------------
+			VM_WIDTH_CASES(OP_LOAD_RM, VM_LOAD_RM)
+			VM_WIDTH_CASES(OP_STORE_MR, VM_STORE_MR)
+			VM_WIDTH_CASES(OP_PUSH, VM_PUSH)
+			VM_WIDTH_CASES(OP_POP, VM_POP)
+			VM_WIDTH_CASES(OP_LOAD_LOCAL, VM_LOAD_LOCAL)
+			VM_WIDTH_CASES(OP_STORE_LOCAL, VM_STORE_LOCAL)
+			VM_WIDTH_CASES(OP_STORE_ENCLOSING_A, VM_STORE_ENCLOSING_A)
+			VM_WIDTH_CASES(OP_LOAD_ENCLOSING_A, VM_LOAD_ENCLOSING_A)
+			VM_WIDTH_CASES(OP_STORE_ENCLOSING_R, VM_STORE_ENCLOSING_R)
+			VM_WIDTH_CASES(OP_LOAD_ENCLOSING_R, VM_LOAD_ENCLOSING_R)
+			VM_WIDTH_CASES(OP_LOAD_STACK, VM_LOAD_STACK)
+			VM_WIDTH_CASES(OP_STORE_STACK, VM_STORE_STACK)
+
+			// Control flow----------------------------
+			VM_CASE(OP_JMP)
+				VM_JUMP(command->destination);
+			VM_CASE(OP_JMP_CV)
+				if (registers[command->source0].u != 0) VM_JUMP(command->destination);
+				VM_NEXT();
+			VM_CASE(OP_JMP_CNV)
+				if (registers[command->source0].u == 0) VM_JUMP(command->destination);
+				VM_NEXT();
+			VM_CASE(OP_CALL)
+				//Call depth and stack of the call depend on the caller: checked by every loop, the unchecked one by the whole use of the callee (source1)
+				if (state->call_stack.full()) VM_ERROR(VMError::STACK_OVERFLOW);
+				if (sp < stack_end + (Policy::checked ? command->source0 : command->source1)) VM_ERROR(VMError::STACK_OVERFLOW);
+				state->call_stack.push_unchecked(CallFrame{ ip + 1, fp });	//Callee's frame is kept by call stack, data stack isnt used
+				fp = sp;
+				sp -= command->source0;
+				VM_PREEMPT(command->destination, 1);	//Fixed charge, VM_JUMP would charge the distance again
+				VM_SAMPLE_POLL();
+				ip = command->destination;
+				VM_DISPATCH();
+			VM_CASE(OP_RET)
 			{
-				result = special_handler(state, command);
+				VM_CHECK(state->call_stack.empty(), VMError::STACK_UNDERFLOW);
+				CallFrame frame = state->call_stack.pop_unchecked();
+				sp = fp;
+				fp = frame.base_ptr;
+				VM_JUMP(frame.return_ip);
 			}
-			if (result == VMError::EXIT)
+			VM_CASE(OP_HALT)
+				ip++;	//Resume continues after HALT
+				goto vm_exit;
+			VM_CASE(OP_JMP_IEQ) VM_INT_JUMP_IF(==)
+			VM_CASE(OP_JMP_INE) VM_INT_JUMP_IF(!=)
+			VM_CASE(OP_JMP_IGT) VM_INT_JUMP_IF(>)
+			VM_CASE(OP_JMP_ILT) VM_INT_JUMP_IF(<)
+			VM_CASE(OP_JMP_IGE) VM_INT_JUMP_IF(>=)
+			VM_CASE(OP_JMP_ILE) VM_INT_JUMP_IF(<=)
+			VM_CASE(OP_JMP_DEQ) VM_DOUBLE_JUMP_IF(==)
+			VM_CASE(OP_JMP_DNE) VM_DOUBLE_JUMP_IF(!=)
+			VM_CASE(OP_JMP_DGT) VM_DOUBLE_JUMP_IF(>)
+			VM_CASE(OP_JMP_DLT) VM_DOUBLE_JUMP_IF(<)
+			VM_CASE(OP_JMP_DGE) VM_DOUBLE_JUMP_IF(>=)
+			VM_CASE(OP_JMP_DLE) VM_DOUBLE_JUMP_IF(<=)
+			VM_CASE(OP_CALL_HOST)
 			{
-				state->flags |= FLAG::STOPPED_FLAG;
-				return result;
+				//Registry is given at run, verify_program cant prove index and arity: checked by every loop
+				if (command->destination >= hosts_size || hosts[command->destination].arguments != command->source1) VM_ERROR(VMError::HOST_FUNCTION_INVALID);
+				VM_CHECK(command->source0 >= REGISTER_COUNT || command->source1 > REGISTER_COUNT - command->source0, VMError::HOST_FUNCTION_INVALID);
+				const HostEntry& host = hosts[command->destination];
+				VM_SAVE_STATE();	//Host function sees the current state
+				state->flags = flags;
+				result = host.function(state, registers + command->source0, host.user_data);
+				if (result != VMError::NO_ERROR) goto vm_error;
+				heap_high = state->heap_high_water;		//Written ranges can be extended by the function
+				stack_low = state->stack_low_water;
+				VM_NEXT();
 			}
-			if (result != VMError::NO_ERROR) 
-			{
-				state->error_stack.push(ErrorFrame(result, state->ip));
-				return result;
+
+			// System calls----------------------------
+			VM_CASE(OP_SYSTEM_CALL)
+				result = syscalls_handler(state, command);
+				if (result != VMError::NO_ERROR) goto vm_error;
+				VM_NEXT();
+
+			// Types convertion------------------------
+			VM_CASE(OP_TC_ITD_R)
+				registers[command->destination].d = static_cast<double>(registers[command->destination].i);
+				VM_NEXT();
+			VM_CASE(OP_TC_DTI_R)
+				registers[command->destination].i = static_cast<int64_t>(registers[command->destination].d);
+				VM_NEXT();
+			VM_CASE(OP_TC_UITD_R)
+				registers[command->destination].d = static_cast<double>(registers[command->destination].u);
+				VM_NEXT();
+			VM_CASE(OP_TC_UITI_R)
+				registers[command->destination].i = static_cast<int64_t>(registers[command->destination].u);
+				VM_NEXT();
+			VM_CASE(OP_TC_DTUI_R)
+				registers[command->destination].u = static_cast<uint64_t>(registers[command->destination].d);
+				VM_NEXT();
+			VM_CASE(OP_TC_ITUI_R)
+				registers[command->destination].u = static_cast<uint64_t>(registers[command->destination].i);
+				VM_NEXT();
+
+			VM_DEFAULT	//Operations without implementation are skipped
+				VM_NEXT();
+#if MALACHITE_COMPUTED_GOTO
+		L_SAMPLE:	//Sample policy, entries were set by VMSampler. Operation of the command is valid (VM_DISPATCH checked it)
+			samples->disarm(dispatch_table.data());
+			samples->take(state, ip);
+			goto *dispatch_table[command->operation];
+		}
+#else
 			}
-			if (state->flags & FLAG::JUMPED_FLAG) continue;
-			state->ip++;
 		}
+#endif
 
+	vm_end:
+		VM_SAVE_STATE();
+		state->flags = flags;
+		if (!Step) state->output.flush();	//Steps are parts of one run, its owner flushes
 		return VMError::NO_ERROR;
+	vm_exit:
+		VM_SAVE_STATE();
+		state->flags = flags | FLAG::STOPPED_FLAG;
+		state->output.flush();
+		return VMError::EXIT;
+	vm_yield:	//Next call continues from ip by STOPPED_FLAG
+		VM_SAVE_STATE();
+		state->flags = flags | FLAG::STOPPED_FLAG;
+		return VMError::YIELD;
+	vm_error:
+		VM_SAVE_STATE();
+		state->flags = flags;
+		state->error_stack.try_push(ErrorFrame(result, ip));	//Full error stack keeps the first errors
+		state->output.flush();
+		return result;
 	}
-	VMError syscalls_handler(VMState* state, VMCommand* command)	
+
+	//execute<Policy> for every combination of policies
+#define VM_INSTANTIATE(C, P, T, S) \
+	template VMError execute<ExecutionPolicy<C, P, T, false, S>>(VMState*, const VMProgram*, const ExecutionOptions&); \
+	template VMError execute<ExecutionPolicy<C, P, T, true, S>>(VMState*, const VMProgram*, const ExecutionOptions&);
+#define VM_INSTANTIATE_ALL(S) \
+	VM_INSTANTIATE(true, false, false, S) VM_INSTANTIATE(true, false, true, S) VM_INSTANTIATE(true, true, false, S) VM_INSTANTIATE(true, true, true, S) \
+	VM_INSTANTIATE(false, false, false, S) VM_INSTANTIATE(false, false, true, S) VM_INSTANTIATE(false, true, false, S) VM_INSTANTIATE(false, true, true, S)
+	VM_INSTANTIATE_ALL(false) VM_INSTANTIATE_ALL(true)
+#undef VM_INSTANTIATE_ALL
+#undef VM_INSTANTIATE
+
+	VMError syscalls_handler(VMState* state, const PackedCommand* command)	
 	{
 		/*In the future will be table of system calls with auto identification and including 
 		c++ dll files.INCLUDE_EXTERNAL-> 
@@ -74,74 +806,37 @@ namespace MalachiteCore
 		return id to malachite high code(loading from register with op_code section help)
 		*/
 		SysCall call = static_cast<SysCall>(command->destination);
+		OutputBuffer& output = state->output;
 		switch (call)
 		{
 		case MalachiteCore::PRINT_INT:
-		{
-			int64_t value = state->registers[command->source0].i;	//Take value from register
-			std::cout << value;
+			output.write_int(state->registers[command->source0].i);	//Take value from register
 			break;
-		}
 		case MalachiteCore::PRINT_UINT:
-		{
-			uint64_t value = state->registers[command->source0].u;	//Take value from register
-			std::cout << value;
+			output.write_uint(state->registers[command->source0].u);	//Take value from register
 			break;
-		}
 		case MalachiteCore::PRINT_CHAR:
-		{
-			putchar(state->registers[command->source0].i);//Take value from register
+			output.write_char(static_cast<char>(state->registers[command->source0].i));	//Take value from register
 			break;
-		}
 		case MalachiteCore::PRINT_DOUBLE:
-		{
-			double value = state->registers[command->source0].d;	//Take value from register
-			std::cout << value;
+			output.write_double(state->registers[command->source0].d);	//Take value from register
 			break;
-		}
 		//Work with char array// char in MEMORY// PRINT_CHAR_ARRAY
 		case MalachiteCore::PRINT_CHAR_ARRAY:
 		{
-			int64_t pointer = state->registers[command->source0].i;	//Take value from register
-			int64_t size = state->registers[command->source1].i;	//Take value from register
+			uint64_t pointer = state->registers[command->source0].u;	//Take value from register
+			uint64_t size = state->registers[command->source1].u;	//Take value from register
 
-			if (pointer + size >= MAX_MEMORY_SIZE) return VMError::MEMORY_ACCESS_VIOLATION;
+			if (size > state->memory_size || pointer > state->memory_size - size) return VMError::MEMORY_ACCESS_VIOLATION;
 
-			char array[size];
-
-			for (size_t i = pointer; i < pointer + size; i++) {
-				putchar(state->memory[pointer + i]);
-			}
-			putchar('\n');  //    
-			}
+			output.write(reinterpret_cast<const char*>(state->memory + pointer), size);	//Whole array by one copy
+			output.write_char('\n');
 			break;
 		}
-		return VMError::NO_ERROR;
-	}
-	VMError special_handler(VMState* state, VMCommand* command)
-	{
-		switch (command->operation) 
-		{
-		case OpCode::OP_TC_ITD_R:
-			state->registers[command->destination].d = static_cast<double>(state->registers[command->destination].i);
-			break;
-		case OpCode::OP_TC_DTI_R:
-			state->registers[command->destination].i = static_cast<int64_t>(state->registers[command->destination].d);
-			break;
-		case OpCode::OP_TC_UITD_R:
-			state->registers[command->destination].d = static_cast<double>(state->registers[command->destination].u);
-			break;
-		case OpCode::OP_TC_UITI_R:
-			state->registers[command->destination].i = static_cast<int64_t>(state->registers[command->destination].u);
-			break;
-		case OpCode::OP_TC_DTUI_R:
-			state->registers[command->destination].u = static_cast<uint64_t>(state->registers[command->destination].d);
-			break;
-		case OpCode::OP_TC_ITUI_R:
-			state->registers[command->destination].u = static_cast<uint64_t>(state->registers[command->destination].i);
+		case MalachiteCore::FLUSH:
+			output.flush();
 			break;
 		}
-
 		return VMError::NO_ERROR;
 	}
 }
\ No newline at end of file
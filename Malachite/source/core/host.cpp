@@ -0,0 +1,25 @@
+#include "../../include/core/host.h"
+
+namespace MalachiteCore
+{
+	uint64_t HostRegistry::add(const std::string& name, const HostSignature& signature, HostFunction function, void* user_data)
+	{
+		if (function == nullptr || m_indices.count(name)) return INVALID_INDEX;
+		for (HostType type : signature.arguments)
+		{
+			if (type == HostType::VOID) return INVALID_INDEX;
+		}
+		uint64_t index = m_entries.size();
+		m_entries.push_back(HostEntry{ function, user_data, signature.arguments.size() });
+		m_names.push_back(name);
+		m_signatures.push_back(signature);
+		m_indices.emplace(name, index);
+		return index;
+	}
+
+	uint64_t HostRegistry::find(const std::string& name) const
+	{
+		auto it = m_indices.find(name);
+		return it != m_indices.end() ? it->second : INVALID_INDEX;
+	}
+}
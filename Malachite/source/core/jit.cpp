@@ -0,0 +1,630 @@
+#include "../../include/core/jit.h"
+#include "../../include/core/functions.h"
+#include <cstddef>
+#include <cstring>
+#include <utility>
+
+#if MALACHITE_JIT
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#undef NO_ERROR		//winerror.h macro hides VMError::NO_ERROR
+#else
+#include <sys/mman.h>
+#endif
+#endif
+
+namespace MalachiteCore
+{
+	namespace
+	{
+		//Exit code of native code: ip - 32 little bits, reason - 8 bits, error - 8 bits
+		enum JITExitReason : uint64_t
+		{
+			JIT_END = 0,		//ip >= commands count
+			JIT_HALT,			//OP_HALT at ip
+			JIT_FALLBACK,		//Command at ip has no template -> execute_step
+			JIT_ERROR,			//Error at ip
+		};
+		constexpr uint64_t JIT_REASON_SHIFT = 32;
+		constexpr uint64_t JIT_ERROR_SHIFT = 40;
+
+		inline uint64_t make_exit(JITExitReason reason, uint64_t ip, VMError error = VMError::NO_ERROR)
+		{
+			return (ip & UINT32_MAX) | (reason << JIT_REASON_SHIFT) | ((uint64_t)error << JIT_ERROR_SHIFT);
+		}
+	}
+
+	JITProgram::JITProgram(JITProgram&& other) noexcept
+	{
+		*this = std::move(other);
+	}
+
+	JITProgram& JITProgram::operator=(JITProgram&& other) noexcept
+	{
+		if (this == &other) return *this;
+		Release();
+		program = std::move(other.program);
+		code = std::exchange(other.code, nullptr);
+		code_size = std::exchange(other.code_size, 0);
+		entry = std::exchange(other.entry, nullptr);
+		native_commands = std::exchange(other.native_commands, 0);
+		return *this;
+	}
+
+	JITProgram::~JITProgram()
+	{
+		Release();
+	}
+
+#if MALACHITE_JIT
+	namespace
+	{
+		void* allocate_writable(size_t size)
+		{
+#if defined(_WIN32)
+			return VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+			void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			return memory == MAP_FAILED ? nullptr : memory;
+#endif
+		}
+
+		bool make_executable(void* memory, size_t size)	//W^X: buffer isnt writable after it
+		{
+#if defined(_WIN32)
+			DWORD old_protection;
+			return VirtualProtect(memory, size, PAGE_EXECUTE_READ, &old_protection) != 0;
+#else
+			return mprotect(memory, size, PROT_READ | PROT_EXEC) == 0;
+#endif
+		}
+
+		void free_executable(void* memory, size_t size)
+		{
+#if defined(_WIN32)
+			VirtualFree(memory, 0, MEM_RELEASE);
+#else
+			munmap(memory, size);
+#endif
+		}
+
+		// x86-64 encoding------------------------------
+		enum Reg : uint8_t { RAX = 0, RCX = 1, RDX = 2, RBX = 3 };	//XMM0/XMM1 use the same numbers
+		enum Condition : uint8_t
+		{
+			CC_B = 0x2, CC_AE = 0x3, CC_E = 0x4, CC_NE = 0x5, CC_BE = 0x6, CC_A = 0x7,
+			CC_P = 0xA, CC_L = 0xC, CC_GE = 0xD, CC_LE = 0xE, CC_G = 0xF,
+		};
+		constexpr uint8_t REX_W = 0x48;
+
+		//Registers are the first member of VMState: register N is [rbx + N * 8], memory is reached through VMState::memory
+		static_assert(offsetof(VMState, registers) == 0, "JIT addresses registers from the start of VMState");
+		constexpr int32_t FP_OFFSET = static_cast<int32_t>(offsetof(VMState, fp));
+		constexpr int32_t FLAGS_OFFSET = static_cast<int32_t>(offsetof(VMState, flags));
+		constexpr int32_t MEMORY_OFFSET = static_cast<int32_t>(offsetof(VMState, memory));
+		constexpr int32_t STACK_START_OFFSET = static_cast<int32_t>(offsetof(VMState, stack_start));
+		constexpr int32_t STACK_END_OFFSET = static_cast<int32_t>(offsetof(VMState, stack_end));
+		constexpr int32_t STACK_LOW_WATER_OFFSET = static_cast<int32_t>(offsetof(VMState, stack_low_water));
+
+		inline int32_t reg_slot(uint64_t reg) { return static_cast<int32_t>(reg * REGISTER_SIZE); }
+
+		struct Emitter
+		{
+			std::vector<uint8_t> code;
+
+			size_t Size() const { return code.size(); }
+			void Bytes(std::initializer_list<uint8_t> bytes) { code.insert(code.end(), bytes.begin(), bytes.end()); }
+			void U32(uint32_t value)
+			{
+				for (int i = 0; i < 4; i++) code.push_back(static_cast<uint8_t>(value >> (i * 8)));
+			}
+			void U64(uint64_t value)
+			{
+				for (int i = 0; i < 8; i++) code.push_back(static_cast<uint8_t>(value >> (i * 8)));
+			}
+			void Patch32(size_t position, uint32_t value)
+			{
+				for (int i = 0; i < 4; i++) code[position + i] = static_cast<uint8_t>(value >> (i * 8));
+			}
+
+			//opcode reg, [rbx + disp32]
+			void Mem(std::initializer_list<uint8_t> opcode, uint8_t reg, int32_t disp)
+			{
+				Bytes(opcode);
+				code.push_back(static_cast<uint8_t>(0x80 | (reg << 3) | RBX));
+				U32(static_cast<uint32_t>(disp));
+			}
+			//opcode reg, [rdx + rax + disp32]
+			void MemIndexed(std::initializer_list<uint8_t> opcode, uint8_t reg, int32_t disp)
+			{
+				Bytes(opcode);
+				code.push_back(static_cast<uint8_t>(0x84 | (reg << 3)));	//SIB follows
+				code.push_back(static_cast<uint8_t>((RAX << 3) | RDX));		//scale 1, index rax, base rdx
+				U32(static_cast<uint32_t>(disp));
+			}
+
+			void LoadQ(uint8_t reg, uint64_t vm_register) { Mem({ REX_W, 0x8B }, reg, reg_slot(vm_register)); }
+			void StoreQ(uint64_t vm_register, uint8_t reg) { Mem({ REX_W, 0x89 }, reg, reg_slot(vm_register)); }
+			void LoadSD(uint8_t xmm, uint64_t vm_register) { Mem({ 0xF2, 0x0F, 0x10 }, xmm, reg_slot(vm_register)); }
+			void StoreSD(uint64_t vm_register, uint8_t xmm) { Mem({ 0xF2, 0x0F, 0x11 }, xmm, reg_slot(vm_register)); }
+
+			//Returns position of rel32 for patching
+			size_t Jump()
+			{
+				Bytes({ 0xE9 });
+				U32(0);
+				return Size() - 4;
+			}
+			size_t JumpIf(Condition condition)
+			{
+				Bytes({ 0x0F, static_cast<uint8_t>(0x80 | condition) });
+				U32(0);
+				return Size() - 4;
+			}
+
+			//mov rax, exit code; pop rbx; ret
+			void Exit(uint64_t exit_code)
+			{
+				Bytes({ REX_W, 0xB8 });
+				U64(exit_code);
+				Bytes({ 0x5B, 0xC3 });
+			}
+		};
+
+		struct JumpPatch
+		{
+			size_t position;	//rel32 position
+			uint64_t target;	//VM ip
+		};
+		struct ErrorPatch
+		{
+			size_t position;
+			uint64_t ip;
+			VMError error;
+		};
+
+		struct Translator
+		{
+			const VMProgram& program;
+			Emitter emitter{};
+			std::vector<JumpPatch> jumps{};
+			std::vector<ErrorPatch> errors{};
+
+			void JumpTo(uint64_t target) { jumps.push_back({ emitter.Jump(), target }); }
+			void JumpToIf(Condition condition, uint64_t target) { jumps.push_back({ emitter.JumpIf(condition), target }); }
+			void ErrorIf(Condition condition, uint64_t ip, VMError error) { errors.push_back({ emitter.JumpIf(condition), ip, error }); }
+
+			//Every register operand has to be real register: another values are left to interpreter
+			bool RegistersValid(const PackedCommand& command)
+			{
+				auto roles = GetOperandRoles(command.operation);
+				auto valid = [](OperandRole role, uint64_t operand)
+					{
+						if (role != ROLE_READ && role != ROLE_WRITE && role != ROLE_READ_WRITE) return true;
+						return operand < REGISTER_COUNT;
+					};
+				return valid(roles.destination, command.destination) && valid(roles.source0, command.source0) && valid(roles.source1, command.source1);
+			}
+
+			void IntBinary(const PackedCommand& command, std::initializer_list<uint8_t> opcode)	//rax = s0 op s1
+			{
+				emitter.LoadQ(RAX, command.source0);
+				emitter.Mem(opcode, RAX, reg_slot(command.source1));
+				emitter.StoreQ(command.destination, RAX);
+			}
+			void IntDivision(const PackedCommand& command, uint64_t ip, bool is_signed, bool remainder)
+			{
+				emitter.LoadQ(RCX, command.source1);
+				emitter.Bytes({ REX_W, 0x85, 0xC9 });		//test rcx, rcx
+				ErrorIf(CC_E, ip, VMError::ZERO_DIVISION);
+				emitter.LoadQ(RAX, command.source0);
+				if (is_signed) emitter.Bytes({ REX_W, 0x99, REX_W, 0xF7, 0xF9 });		//cqo; idiv rcx
+				else emitter.Bytes({ 0x31, 0xD2, REX_W, 0xF7, 0xF1 });					//xor edx, edx; div rcx
+				emitter.StoreQ(command.destination, remainder ? RDX : RAX);
+			}
+			void DoubleBinary(const PackedCommand& command, uint8_t opcode)	//xmm0 = s0 op s1
+			{
+				emitter.LoadSD(0, command.source0);
+				emitter.Mem({ 0xF2, 0x0F, opcode }, 0, reg_slot(command.source1));
+				emitter.StoreSD(command.destination, 0);
+			}
+			void LogicBinary(const PackedCommand& command, uint8_t combine)	//(s0 != 0) op (s1 != 0)
+			{
+				emitter.LoadQ(RAX, command.source0);
+				emitter.LoadQ(RCX, command.source1);
+				emitter.Bytes({ REX_W, 0x85, 0xC0, 0x0F, 0x95, 0xC0 });	//test rax, rax; setne al
+				emitter.Bytes({ REX_W, 0x85, 0xC9, 0x0F, 0x95, 0xC1 });	//test rcx, rcx; setne cl
+				emitter.Bytes({ combine, 0xC8, 0x0F, 0xB6, 0xC0 });		//and/or al, cl; movzx eax, al
+				emitter.StoreQ(command.destination, RAX);
+			}
+			void Shift(const PackedCommand& command, uint8_t modrm)
+			{
+				emitter.LoadQ(RAX, command.source0);
+				emitter.LoadQ(RCX, command.source1);
+				emitter.Bytes({ REX_W, 0xD3, modrm });		//shl/sar rax, cl
+				emitter.StoreQ(command.destination, RAX);
+			}
+			void IntJump(const PackedCommand& command, Condition condition)
+			{
+				emitter.LoadQ(RAX, command.source0);
+				emitter.Mem({ REX_W, 0x3B }, RAX, reg_slot(command.source1));	//cmp rax, s1
+				JumpToIf(condition, command.destination);
+			}
+			void DoubleJump(const PackedCommand& command, uint64_t ip, Condition condition)
+			{
+				emitter.LoadSD(0, command.source0);
+				emitter.Mem({ 0x66, 0x0F, 0x2E }, 0, reg_slot(command.source1));	//ucomisd xmm0, s1
+				ErrorIf(CC_P, ip, VMError::NAN_FLOAT_VALUE);						//unordered -> NaN
+				JumpToIf(condition, command.destination);
+			}
+
+			//rax = address of the last slot byte (base - offset), rdx = memory. Slot starts at [rdx + rax - size + 1]. Same checks as frame_slot.
+			//base is fp for locals and stack_start for *_STACK commands
+			void FrameSlot(uint64_t offset, uint64_t size, uint64_t ip, int32_t base)
+			{
+				emitter.Mem({ REX_W, 0x8B }, RAX, base);					//mov rax, base
+				emitter.Bytes({ REX_W, 0x2D }); emitter.U32(static_cast<uint32_t>(offset));	//sub rax, offset
+				ErrorIf(CC_B, ip, VMError::MEMORY_ACCESS_VIOLATION);
+				emitter.Mem({ REX_W, 0x8B }, RDX, STACK_END_OFFSET);		//mov rdx, stack_end
+				emitter.Bytes({ REX_W, 0x83, 0xC2, static_cast<uint8_t>(size) });	//add rdx, size
+				emitter.Bytes({ REX_W, 0x39, 0xD0 });						//cmp rax, rdx
+				ErrorIf(CC_B, ip, VMError::MEMORY_ACCESS_VIOLATION);
+				emitter.Mem({ REX_W, 0x3B }, RAX, STACK_START_OFFSET);		//cmp rax, stack_start
+				ErrorIf(CC_A, ip, VMError::MEMORY_ACCESS_VIOLATION);
+				emitter.Mem({ REX_W, 0x8B }, RDX, MEMORY_OFFSET);			//mov rdx, memory
+			}
+			void LoadLocal(const PackedCommand& command, uint64_t size, uint64_t ip, int32_t base = FP_OFFSET)
+			{
+				FrameSlot(command.source0, size, ip, base);
+				int32_t disp = 1 - static_cast<int32_t>(size);
+				switch (size)
+				{
+				case 1: emitter.MemIndexed({ 0x0F, 0xB6 }, RAX, disp); break;	//movzx eax, byte
+				case 2: emitter.MemIndexed({ 0x0F, 0xB7 }, RAX, disp); break;	//movzx eax, word
+				case 4: emitter.MemIndexed({ 0x8B }, RAX, disp); break;			//mov eax, dword
+				default: emitter.MemIndexed({ REX_W, 0x8B }, RAX, disp); break;
+				}
+				emitter.StoreQ(command.destination, RAX);
+			}
+			void StoreLocal(const PackedCommand& command, uint64_t size, uint64_t ip, int32_t base = FP_OFFSET)
+			{
+				FrameSlot(command.destination, size, ip, base);
+				emitter.LoadQ(RCX, command.source0);
+				int32_t disp = 1 - static_cast<int32_t>(size);
+				switch (size)
+				{
+				case 1: emitter.MemIndexed({ 0x88 }, RCX, disp); break;			//mov byte, cl
+				case 2: emitter.MemIndexed({ 0x66, 0x89 }, RCX, disp); break;	//mov word, cx
+				case 4: emitter.MemIndexed({ 0x89 }, RCX, disp); break;			//mov dword, ecx
+				default: emitter.MemIndexed({ REX_W, 0x89 }, RCX, disp); break;
+				}
+				//stack_low_water = min(stack_low_water, slot start)
+				emitter.Bytes({ REX_W, 0x8D, 0x40, static_cast<uint8_t>(disp) });	//lea rax, [rax + disp8]
+				emitter.Mem({ REX_W, 0x3B }, RAX, STACK_LOW_WATER_OFFSET);			//cmp rax, stack_low_water
+				emitter.Bytes({ 0x73, 0x07 });										//jae +7
+				emitter.Mem({ REX_W, 0x89 }, RAX, STACK_LOW_WATER_OFFSET);
+			}
+
+			//false -> command has no template
+			bool Translate(const PackedCommand& command, uint64_t ip)
+			{
+				if (!RegistersValid(command)) return false;
+				switch (command.operation)
+				{
+				case OP_NOP:
+				case OP_TC_UITI_R:		//Same bits
+				case OP_TC_ITUI_R:
+					return true;
+
+				// Arithmetic
+				case OP_IADD_RRR: case OP_UADD_RRR: IntBinary(command, { REX_W, 0x03 }); return true;
+				case OP_ISUB_RRR: case OP_USUB_RRR: IntBinary(command, { REX_W, 0x2B }); return true;
+				case OP_IMUL_RRR: case OP_UMUL_RRR: IntBinary(command, { REX_W, 0x0F, 0xAF }); return true;
+				case OP_IDIV_RRR: IntDivision(command, ip, true, false); return true;
+				case OP_IMOD_RRR: IntDivision(command, ip, true, true); return true;
+				case OP_UDIV_RRR: IntDivision(command, ip, false, false); return true;
+				case OP_UMOD_RRR: IntDivision(command, ip, false, true); return true;
+				case OP_INEG_RR:
+					emitter.LoadQ(RAX, command.source0);
+					emitter.Bytes({ REX_W, 0xF7, 0xD8 });	//neg rax
+					emitter.StoreQ(command.destination, RAX);
+					return true;
+				case OP_DADD_RRR: DoubleBinary(command, 0x58); return true;
+				case OP_DSUB_RRR: DoubleBinary(command, 0x5C); return true;
+				case OP_DMUL_RRR: DoubleBinary(command, 0x59); return true;
+				case OP_DDIV_RRR:
+					emitter.Bytes({ 0x66, 0x0F, 0x57, 0xC9 });							//xorpd xmm1, xmm1
+					emitter.Mem({ 0x66, 0x0F, 0x2E }, 1, reg_slot(command.source1));	//ucomisd xmm1, s1
+					emitter.Bytes({ 0x7A, 0x06 });										//jp +6: NaN isnt zero
+					ErrorIf(CC_E, ip, VMError::ZERO_DIVISION);
+					DoubleBinary(command, 0x5E);
+					return true;
+				case OP_DNEG_RR:
+					emitter.LoadQ(RAX, command.source0);
+					emitter.Bytes({ REX_W, 0x0F, 0xBA, 0xF8, 0x3F });	//btc rax, 63
+					emitter.StoreQ(command.destination, RAX);
+					return true;
+
+				// Logic
+				case OP_AND_RRR: LogicBinary(command, 0x20); return true;
+				case OP_OR_RRR: LogicBinary(command, 0x08); return true;
+				case OP_NOT_RR:
+					emitter.LoadQ(RAX, command.source0);
+					emitter.Bytes({ REX_W, 0x85, 0xC0, 0x0F, 0x94, 0xC0, 0x0F, 0xB6, 0xC0 });	//test rax, rax; sete al; movzx eax, al
+					emitter.StoreQ(command.destination, RAX);
+					return true;
+				case OP_BIT_AND_RRR: IntBinary(command, { REX_W, 0x23 }); return true;
+				case OP_BIT_OR_RRR: IntBinary(command, { REX_W, 0x0B }); return true;
+				case OP_BIT_NOT_RR:
+					emitter.LoadQ(RAX, command.source0);
+					emitter.Bytes({ REX_W, 0xF7, 0xD0 });	//not rax
+					emitter.StoreQ(command.destination, RAX);
+					return true;
+				case OP_BIT_OFFSET_LEFT_RRR: Shift(command, 0xE0); return true;
+				case OP_BIT_OFFSET_RIGHT_RRR: Shift(command, 0xF8); return true;
+				case OP_CMP_RR:
+					emitter.LoadQ(RAX, command.source0);
+					emitter.Mem({ REX_W, 0x3B }, RAX, reg_slot(command.source1));	//cmp rax, s1
+					emitter.Bytes({ 0xBA }); emitter.U32(FLAG::EQUAL_FLAG);			//mov edx, EQUAL
+					emitter.Bytes({ 0xB8 }); emitter.U32(FLAG::GREATER_FLAG | FLAG::NOT_EQUAL_FLAG);
+					emitter.Bytes({ 0x0F, 0x4F, 0xD0 });								//cmovg edx, eax
+					emitter.Bytes({ 0xB8 }); emitter.U32(FLAG::LESS_FLAG | FLAG::NOT_EQUAL_FLAG);
+					emitter.Bytes({ 0x0F, 0x4C, 0xD0 });								//cmovl edx, eax
+					emitter.Mem({ 0x8B }, RCX, FLAGS_OFFSET);							//mov ecx, flags
+					emitter.Bytes({ 0x81, 0xE1 }); emitter.U32(~(uint32_t)(FLAG::EQUAL_FLAG | FLAG::NOT_EQUAL_FLAG | FLAG::LESS_FLAG | FLAG::GREATER_FLAG));
+					emitter.Bytes({ 0x09, 0xD1 });										//or ecx, edx
+					emitter.Mem({ 0x89 }, RCX, FLAGS_OFFSET);
+					return true;
+				case OP_GET_FLAG:
+					emitter.Mem({ 0x8B }, RAX, FLAGS_OFFSET);				//mov eax, flags
+					emitter.Bytes({ 0x25 }); emitter.U32(command.source0);	//and eax, flag
+					emitter.StoreQ(command.destination, RAX);
+					return true;
+
+				// Memory
+				case OP_MOV_RR:
+					emitter.LoadQ(RAX, command.source0);
+					emitter.StoreQ(command.destination, RAX);
+					return true;
+				case OP_MOV_RI_INT:
+					emitter.Mem({ REX_W, 0xC7 }, 0, reg_slot(command.destination));	//mov qword, sign-extended imm32
+					emitter.U32(command.source0);
+					return true;
+				case OP_MOV_RI_UINT:
+					emitter.Bytes({ 0xB8 }); emitter.U32(command.source0);			//mov eax, imm32 (zero-extended)
+					emitter.StoreQ(command.destination, RAX);
+					return true;
+				case OP_MOV_RC:
+					if (command.source0 >= program.constants.size()) return false;
+					emitter.Bytes({ REX_W, 0xB8 }); emitter.U64(program.constants[command.source0].u);
+					emitter.StoreQ(command.destination, RAX);
+					return true;
+				case OP_LOAD_LOCAL_U8: LoadLocal(command, 1, ip); return true;
+				case OP_LOAD_LOCAL_U16: LoadLocal(command, 2, ip); return true;
+				case OP_LOAD_LOCAL_U32: LoadLocal(command, 4, ip); return true;
+				case OP_LOAD_LOCAL_U64: LoadLocal(command, 8, ip); return true;
+				case OP_STORE_LOCAL_U8: StoreLocal(command, 1, ip); return true;
+				case OP_STORE_LOCAL_U16: StoreLocal(command, 2, ip); return true;
+				case OP_STORE_LOCAL_U32: StoreLocal(command, 4, ip); return true;
+				case OP_STORE_LOCAL_U64: StoreLocal(command, 8, ip); return true;
+				case OP_LOAD_STACK_U8: LoadLocal(command, 1, ip, STACK_START_OFFSET); return true;
+				case OP_LOAD_STACK_U16: LoadLocal(command, 2, ip, STACK_START_OFFSET); return true;
+				case OP_LOAD_STACK_U32: LoadLocal(command, 4, ip, STACK_START_OFFSET); return true;
+				case OP_LOAD_STACK_U64: LoadLocal(command, 8, ip, STACK_START_OFFSET); return true;
+				case OP_STORE_STACK_U8: StoreLocal(command, 1, ip, STACK_START_OFFSET); return true;
+				case OP_STORE_STACK_U16: StoreLocal(command, 2, ip, STACK_START_OFFSET); return true;
+				case OP_STORE_STACK_U32: StoreLocal(command, 4, ip, STACK_START_OFFSET); return true;
+				case OP_STORE_STACK_U64: StoreLocal(command, 8, ip, STACK_START_OFFSET); return true;
+
+				// Control flow
+				case OP_JMP: JumpTo(command.destination); return true;
+				case OP_JMP_CV:
+				case OP_JMP_CNV:
+					emitter.Mem({ REX_W, 0x83 }, 7, reg_slot(command.source0));	//cmp qword s0, 0
+					emitter.Bytes({ 0x00 });
+					JumpToIf(command.operation == OP_JMP_CV ? CC_NE : CC_E, command.destination);
+					return true;
+				case OP_HALT: emitter.Exit(make_exit(JIT_HALT, ip)); return true;
+				case OP_JMP_IEQ: IntJump(command, CC_E); return true;
+				case OP_JMP_INE: IntJump(command, CC_NE); return true;
+				case OP_JMP_IGT: IntJump(command, CC_G); return true;
+				case OP_JMP_ILT: IntJump(command, CC_L); return true;
+				case OP_JMP_IGE: IntJump(command, CC_GE); return true;
+				case OP_JMP_ILE: IntJump(command, CC_LE); return true;
+				case OP_JMP_DEQ: DoubleJump(command, ip, CC_E); return true;
+				case OP_JMP_DNE: DoubleJump(command, ip, CC_NE); return true;
+				case OP_JMP_DGT: DoubleJump(command, ip, CC_A); return true;
+				case OP_JMP_DLT: DoubleJump(command, ip, CC_B); return true;
+				case OP_JMP_DGE: DoubleJump(command, ip, CC_AE); return true;
+				case OP_JMP_DLE: DoubleJump(command, ip, CC_BE); return true;
+
+				// Types convertion
+				case OP_TC_ITD_R:
+					emitter.Mem({ 0xF2, REX_W, 0x0F, 0x2A }, 0, reg_slot(command.destination));	//cvtsi2sd xmm0, qword
+					emitter.StoreSD(command.destination, 0);
+					return true;
+				case OP_TC_DTI_R:
+					emitter.Mem({ 0xF2, REX_W, 0x0F, 0x2C }, RAX, reg_slot(command.destination));	//cvttsd2si rax, qword
+					emitter.StoreQ(command.destination, RAX);
+					return true;
+				default:
+					return false;
+				}
+			}
+
+			//Layout: entry stub | command blocks | end and error stubs | int32 table (ip -> block offset from table)
+			bool Build(size_t& native_commands)
+			{
+				const auto& code = program.code;
+				size_t commands_size = code.size();
+#if defined(_WIN32)
+				emitter.Bytes({ 0x53, REX_W, 0x89, 0xCB, REX_W, 0x89, 0xD0 });	//push rbx; mov rbx, rcx; mov rax, rdx
+#else
+				emitter.Bytes({ 0x53, REX_W, 0x89, 0xFB, REX_W, 0x89, 0xF0 });	//push rbx; mov rbx, rdi; mov rax, rsi
+#endif
+				emitter.Bytes({ REX_W, 0x8D, 0x0D });		//lea rcx, [rip + table]
+				size_t table_reference = emitter.Size();
+				emitter.U32(0);
+				emitter.Bytes({ REX_W, 0x63, 0x04, 0x81, REX_W, 0x01, 0xC8, 0xFF, 0xE0 });	//movsxd rax, [rcx + rax * 4]; add rax, rcx; jmp rax
+
+				std::vector<size_t> blocks(commands_size + 1);
+				native_commands = 0;
+				for (size_t ip = 0; ip < commands_size; ip++)
+				{
+					blocks[ip] = emitter.Size();
+					size_t rollback = emitter.Size();
+					size_t jumps_size = jumps.size(), errors_size = errors.size();
+					if (Translate(code[ip], ip))
+					{
+						native_commands++;
+						continue;
+					}
+					emitter.code.resize(rollback);
+					jumps.resize(jumps_size);
+					errors.resize(errors_size);
+					emitter.Exit(make_exit(JIT_FALLBACK, ip));
+				}
+				blocks[commands_size] = emitter.Size();
+				emitter.Exit(make_exit(JIT_END, commands_size));
+
+				for (auto& jump : jumps)
+				{
+					size_t target;
+					if (jump.target <= commands_size) target = blocks[jump.target];
+					else
+					{
+						target = emitter.Size();	//Jump out of code ends execution as in interpreter
+						emitter.Exit(make_exit(JIT_END, jump.target));
+					}
+					emitter.Patch32(jump.position, static_cast<uint32_t>(target - (jump.position + 4)));
+				}
+				for (auto& error : errors)
+				{
+					emitter.Patch32(error.position, static_cast<uint32_t>(emitter.Size() - (error.position + 4)));
+					emitter.Exit(make_exit(JIT_ERROR, error.ip, error.error));
+				}
+
+				while (emitter.Size() % 4 != 0) emitter.Bytes({ 0xCC });
+				size_t table = emitter.Size();
+				emitter.Patch32(table_reference, static_cast<uint32_t>(table - (table_reference + 4)));
+				for (size_t ip = 0; ip <= commands_size; ip++) emitter.U32(static_cast<uint32_t>(static_cast<int32_t>(blocks[ip] - table)));
+				return emitter.Size() <= INT32_MAX;
+			}
+		};
+	}
+
+	bool jit_available()
+	{
+		return true;
+	}
+
+	void JITProgram::Release()
+	{
+		if (code != nullptr) free_executable(code, code_size);
+		code = nullptr;
+		code_size = 0;
+		entry = nullptr;
+		native_commands = 0;
+	}
+
+	VMError jit_compile(const VMProgram* program, JITProgram& jit)
+	{
+		jit.Release();
+		if (program == nullptr || program->code.empty()) return VMError::VMCS_INVALID;
+		jit.program = *program;
+
+		Translator translator{ jit.program };
+		size_t native_commands = 0;
+		if (!translator.Build(native_commands)) return VMError::NO_ERROR;	//Too big, interpreted
+
+		size_t size = translator.emitter.Size();
+		void* memory = allocate_writable(size);
+		if (memory == nullptr) return VMError::NO_ERROR;
+		memcpy(memory, translator.emitter.code.data(), size);
+		if (!make_executable(memory, size))
+		{
+			free_executable(memory, size);
+			return VMError::NO_ERROR;
+		}
+		jit.code = memory;
+		jit.code_size = size;
+		jit.entry = reinterpret_cast<JITProgram::Entry>(memory);
+		jit.native_commands = native_commands;
+		return VMError::NO_ERROR;
+	}
+#else
+	bool jit_available()
+	{
+		return false;
+	}
+
+	void JITProgram::Release()
+	{
+		code = nullptr;
+		code_size = 0;
+		entry = nullptr;
+		native_commands = 0;
+	}
+
+	VMError jit_compile(const VMProgram* program, JITProgram& jit)
+	{
+		jit.Release();
+		if (program == nullptr || program->code.empty()) return VMError::VMCS_INVALID;
+		jit.program = *program;
+		return VMError::NO_ERROR;
+	}
+#endif
+
+	VMError jit_compile(const VMCommand* commands, size_t commands_size, JITProgram& jit)
+	{
+		VMProgram program;
+		VMError result = encode_program(commands, commands_size, program);
+		if (result != VMError::NO_ERROR) return result;
+		return jit_compile(&program, jit);
+	}
+
+	VMError execute_jit(VMState* state, const JITProgram* jit)
+	{
+		if (state == nullptr)return VMError::VMS_PTR_INVALID;
+		if (jit == nullptr || jit->program.code.empty()) return VMError::VMCS_INVALID;
+		if (jit->entry == nullptr) return execute(state, &jit->program);
+
+		if (!(state->flags & FLAG::STOPPED_FLAG))state->ip = 0;
+		else state->flags &= ~FLAG::STOPPED_FLAG;
+
+		const size_t commands_size = jit->program.code.size();
+		while (state->ip < commands_size)
+		{
+			uint64_t exit_code = jit->entry(state, state->ip);
+			state->ip = exit_code & UINT32_MAX;
+			switch (static_cast<JITExitReason>((exit_code >> JIT_REASON_SHIFT) & 0xFF))
+			{
+			case JIT_END:
+				state->output.flush();
+				return VMError::NO_ERROR;
+			case JIT_HALT:
+				state->ip++;	//Same as interpreter: resume continues after HALT
+				state->flags |= FLAG::STOPPED_FLAG;
+				state->output.flush();
+				return VMError::EXIT;
+			case JIT_ERROR:
+			{
+				VMError error = static_cast<VMError>((exit_code >> JIT_ERROR_SHIFT) & 0xFF);
+				state->error_stack.try_push(ErrorFrame(error, state->ip));
+				state->output.flush();
+				return error;
+			}
+			case JIT_FALLBACK:
+			{
+				VMError result = execute_step(state, &jit->program);
+				if (result != VMError::NO_ERROR) return result;
+				break;
+			}
+			}
+		}
+		state->output.flush();
+		return VMError::NO_ERROR;
+	}
+}
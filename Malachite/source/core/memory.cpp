@@ -0,0 +1,241 @@
+#include "../../include/core/memory.h"
+#include <cstring>
+#include <new>
+#include <utility>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#undef NO_ERROR		//winerror.h macro hides VMError::NO_ERROR
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace MalachiteCore
+{
+	namespace
+	{
+		inline size_t round_up(size_t value, size_t alignment)
+		{
+			return (value + alignment - 1) / alignment * alignment;
+		}
+
+#if defined(_WIN32)
+		void* map_memory(size_t size, bool huge_pages, size_t& mapped)
+		{
+			size_t large_page = GetLargePageMinimum();
+			if (huge_pages && large_page != 0)	//Needs SeLockMemoryPrivilege, large pages are committed at once
+			{
+				mapped = round_up(size, large_page);
+				void* memory = VirtualAlloc(nullptr, mapped, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+				if (memory != nullptr) return memory;
+			}
+			SYSTEM_INFO info;
+			GetSystemInfo(&info);
+			mapped = round_up(size, info.dwPageSize);
+			//Committed pages get physical memory only on first access
+			return VirtualAlloc(nullptr, mapped, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+		}
+
+		void unmap_memory(void* memory, size_t, bool view)
+		{
+			if (view) UnmapViewOfFile(memory);
+			else VirtualFree(memory, 0, MEM_RELEASE);
+		}
+
+		void* create_section(size_t mapped)
+		{
+			return CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, static_cast<DWORD>(static_cast<uint64_t>(mapped) >> 32), static_cast<DWORD>(mapped), nullptr);
+		}
+#else
+		void* map_memory(size_t size, bool huge_pages, size_t& mapped)
+		{
+			mapped = round_up(size, static_cast<size_t>(sysconf(_SC_PAGESIZE)));
+			int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#if defined(MAP_NORESERVE)
+			flags |= MAP_NORESERVE;
+#endif
+			void* memory = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, flags, -1, 0);
+			if (memory == MAP_FAILED) return nullptr;
+#if defined(MADV_HUGEPAGE)
+			if (huge_pages) madvise(memory, mapped, MADV_HUGEPAGE);	//Transparent huge pages, only a hint
+#else
+			(void)huge_pages;
+#endif
+			return memory;
+		}
+
+		void unmap_memory(void* memory, size_t mapped, bool)
+		{
+			munmap(memory, mapped);
+		}
+#endif
+
+		void copy_ranges(uint8_t* destination, const uint8_t* source, size_t size, const std::vector<MemoryRange>& ranges)
+		{
+			for (auto& range : ranges)
+			{
+				if (range.offset >= size) continue;
+				memcpy(destination + range.offset, source + range.offset, range.size < size - range.offset ? range.size : size - range.offset);
+			}
+		}
+
+		//Whole pages inside [begin, begin + size) are dropped, the next access maps zeroed pages. false -> memset is needed
+		bool discard_pages(uint8_t* begin, size_t size)
+		{
+#if !defined(_WIN32) && defined(MADV_DONTNEED)
+			size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+			uintptr_t first = round_up(reinterpret_cast<uintptr_t>(begin), page);
+			uintptr_t last = (reinterpret_cast<uintptr_t>(begin) + size) / page * page;
+			if (last <= first) return false;
+			if (madvise(reinterpret_cast<void*>(first), last - first, MADV_DONTNEED) != 0) return false;
+			memset(begin, 0, first - reinterpret_cast<uintptr_t>(begin));
+			memset(reinterpret_cast<uint8_t*>(last), 0, reinterpret_cast<uintptr_t>(begin) + size - last);
+			return true;
+#else
+			(void)begin;
+			(void)size;
+			return false;
+#endif
+		}
+	}
+
+	VMMemory::VMMemory(size_t size, bool huge_pages)
+	{
+		if (size == 0) return;
+		m_data = static_cast<uint8_t*>(map_memory(size, huge_pages && size >= HUGE_PAGES_MIN_SIZE, m_mapped));
+		if (m_data == nullptr) throw std::bad_alloc();
+		m_size = size;
+	}
+
+	MemoryImage::MemoryImage(const uint8_t* data, size_t size, const std::vector<MemoryRange>& ranges) : m_size(size)
+	{
+#if defined(_WIN32)
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		m_mapped = round_up(size, info.dwPageSize);
+		m_section = create_section(m_mapped);
+		if (m_section != nullptr)
+		{
+			void* view = MapViewOfFile(m_section, FILE_MAP_WRITE, 0, 0, m_mapped);
+			if (view != nullptr)
+			{
+				copy_ranges(static_cast<uint8_t*>(view), data, size, ranges);
+				UnmapViewOfFile(view);
+				return;
+			}
+			CloseHandle(m_section);
+			m_section = nullptr;
+		}
+#else
+		m_mapped = round_up(size, static_cast<size_t>(sysconf(_SC_PAGESIZE)));
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+		m_fd = memfd_create("malachite-image", MFD_CLOEXEC);	//Sparse file: not saved pages take no memory
+		if (m_fd >= 0)
+		{
+			void* view = ftruncate(m_fd, static_cast<off_t>(m_mapped)) == 0 ? mmap(nullptr, m_mapped, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0) : MAP_FAILED;
+			if (view != MAP_FAILED)
+			{
+				copy_ranges(static_cast<uint8_t*>(view), data, size, ranges);
+				munmap(view, m_mapped);
+				return;
+			}
+			close(m_fd);
+			m_fd = -1;
+		}
+#endif
+#endif
+		//Fallback: saved bytes are copied to every fork
+		for (auto& range : ranges)
+		{
+			if (range.offset >= size) continue;
+			MemoryRange saved{ range.offset, range.size < size - range.offset ? range.size : size - range.offset };
+			m_ranges.push_back(saved);
+			m_bytes.insert(m_bytes.end(), data + saved.offset, data + saved.offset + saved.size);
+		}
+	}
+
+	MemoryImage::~MemoryImage()
+	{
+#if defined(_WIN32)
+		if (m_section != nullptr) CloseHandle(m_section);
+#else
+		if (m_fd >= 0) close(m_fd);
+#endif
+	}
+
+	VMMemory::VMMemory(const MemoryImage& image)
+	{
+		if (image.m_size == 0) return;
+#if defined(_WIN32)
+		if (image.m_section != nullptr)
+		{
+			m_data = static_cast<uint8_t*>(MapViewOfFile(image.m_section, FILE_MAP_COPY, 0, 0, image.m_mapped));
+			m_view = m_data != nullptr;
+		}
+#else
+		if (image.m_fd >= 0)
+		{
+			void* memory = mmap(nullptr, image.m_mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE, image.m_fd, 0);
+			m_data = memory == MAP_FAILED ? nullptr : static_cast<uint8_t*>(memory);
+			m_view = m_data != nullptr;
+		}
+#endif
+		if (image.shared_pages() && !m_view) throw std::bad_alloc();	//Saved bytes are only in the image pages
+		if (m_view)
+		{
+			m_size = image.m_size;
+			m_mapped = image.m_mapped;
+			return;
+		}
+		m_data = static_cast<uint8_t*>(map_memory(image.m_size, false, m_mapped));
+		if (m_data == nullptr) throw std::bad_alloc();
+		m_size = image.m_size;
+		size_t position = 0;
+		for (auto& range : image.m_ranges)
+		{
+			memcpy(m_data + range.offset, image.m_bytes.data() + position, range.size);
+			position += range.size;
+		}
+	}
+
+	VMMemory::VMMemory(VMMemory&& other) noexcept
+	{
+		*this = std::move(other);
+	}
+
+	VMMemory& VMMemory::operator=(VMMemory&& other) noexcept
+	{
+		if (this == &other) return *this;
+		release();
+		m_data = std::exchange(other.m_data, nullptr);
+		m_size = std::exchange(other.m_size, 0);
+		m_mapped = std::exchange(other.m_mapped, 0);
+		m_view = std::exchange(other.m_view, false);
+		return *this;
+	}
+
+	VMMemory::~VMMemory()
+	{
+		release();
+	}
+
+	void VMMemory::zero(size_t offset, size_t size)
+	{
+		if (m_data == nullptr || offset >= m_size || size == 0) return;
+		if (size > m_size - offset) size = m_size - offset;
+		if (!m_view && size >= DISCARD_MIN_SIZE && discard_pages(m_data + offset, size)) return;
+		memset(m_data + offset, 0, size);
+	}
+
+	void VMMemory::release()
+	{
+		if (m_data != nullptr) unmap_memory(m_data, m_mapped, m_view);
+		m_data = nullptr;
+		m_size = 0;
+		m_mapped = 0;
+		m_view = false;
+	}
+}
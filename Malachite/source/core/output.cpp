@@ -0,0 +1,77 @@
+#include "../../include/core/output.h"
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <cerrno>
+#include <unistd.h>
+#endif
+
+namespace MalachiteCore
+{
+	namespace
+	{
+		constexpr size_t NUMBER_TEXT_SIZE = 32;		//Longest int64, uint64 and %g double text
+
+		//Whole range is written, short writes are repeated. Returns false if the descriptor refuses
+		bool write_all(int descriptor, const char* data, size_t size)
+		{
+			while (size > 0)
+			{
+#if defined(_WIN32)
+				unsigned int part = size > INT32_MAX ? INT32_MAX : static_cast<unsigned int>(size);
+				int written = _write(descriptor, data, part);
+				if (written <= 0) return false;
+#else
+				ssize_t written = ::write(descriptor, data, size);
+				if (written < 0 && errno == EINTR) continue;
+				if (written <= 0) return false;
+#endif
+				data += written;
+				size -= static_cast<size_t>(written);
+			}
+			return true;
+		}
+	}
+
+	void OutputBuffer::write_int(int64_t value)
+	{
+		char* place = reserve(NUMBER_TEXT_SIZE);
+		m_size = std::to_chars(place, place + NUMBER_TEXT_SIZE, value).ptr - m_data;
+	}
+
+	void OutputBuffer::write_uint(uint64_t value)
+	{
+		char* place = reserve(NUMBER_TEXT_SIZE);
+		m_size = std::to_chars(place, place + NUMBER_TEXT_SIZE, value).ptr - m_data;
+	}
+
+	void OutputBuffer::write_double(double value)
+	{
+		char* place = reserve(NUMBER_TEXT_SIZE);
+		m_size = std::to_chars(place, place + NUMBER_TEXT_SIZE, value, std::chars_format::general, 6).ptr - m_data;
+	}
+
+	void OutputBuffer::write(const char* data, size_t size)
+	{
+		if (size > OUTPUT_BUFFER_SIZE)	//Big text isnt copied: buffered part is written first, then the text itself
+		{
+			flush();
+			write_all(m_descriptor, data, size);
+			return;
+		}
+		memcpy(reserve(size), data, size);
+		m_size += size;
+	}
+
+	void OutputBuffer::flush()
+	{
+		if (m_size == 0) return;
+		if (m_descriptor == OUTPUT_STDOUT) fflush(stdout);	//std::cout text written before is in front
+		write_all(m_descriptor, m_data, m_size);
+		m_size = 0;
+	}
+}
@@ -0,0 +1,42 @@
+#include "../../include/core/pool.h"
+
+namespace MalachiteCore
+{
+	VMStatePool::VMStatePool(const MemoryConfig& config, size_t max_size) : m_config(config), m_max_size(max_size)
+	{
+		m_states.reserve(max_size);
+	}
+
+	std::unique_ptr<VMState> VMStatePool::acquire()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (!m_states.empty())
+			{
+				auto state = std::move(m_states.back());
+				m_states.pop_back();
+				return state;
+			}
+		}
+		return std::make_unique<VMState>(m_config);
+	}
+
+	void VMStatePool::release(std::unique_ptr<VMState> state)
+	{
+		if (state == nullptr) return;
+		if (state->memory_size != m_config.memory_size() || state->stack_start - state->stack_end + 1 != m_config.stack_size) return;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_states.size() >= m_max_size) return;
+		}
+		state->reset();		//Out of lock: another threads dont wait for memset
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_states.size() < m_max_size) m_states.push_back(std::move(state));
+	}
+
+	size_t VMStatePool::size() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_states.size();
+	}
+}
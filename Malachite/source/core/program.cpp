@@ -0,0 +1,101 @@
+#include "../../include/core/program.h"
+#include <unordered_map>
+
+namespace MalachiteCore
+{
+	namespace
+	{
+		inline bool fits_u32(uint64_t value)
+		{
+			return value <= UINT32_MAX;
+		}
+
+		inline bool fits_i32(int64_t value)
+		{
+			return value >= INT32_MIN && value <= INT32_MAX;
+		}
+
+		struct ConstantPoolBuilder
+		{
+			std::vector<Register>& constants;
+			std::unordered_map<uint64_t, uint32_t> indices{};	//raw bits -> index, equal constants are stored once
+
+			uint32_t Add(Register value)
+			{
+				auto it = indices.find(value.u);
+				if (it != indices.end()) return it->second;
+				uint32_t index = static_cast<uint32_t>(constants.size());
+				constants.push_back(value);
+				indices.insert({ value.u, index });
+				return index;
+			}
+		};
+	}
+
+	VMError encode_program(const VMCommand* commands, size_t commands_size, VMProgram& program)
+	{
+		program.code.clear();
+		program.constants.clear();
+		program.verification = ProgramVerification();
+		if (commands == nullptr || commands_size == 0) return VMError::VMCS_INVALID;
+		if (!fits_u32(commands_size)) return VMError::VMCS_INVALID;
+
+		program.code.reserve(commands_size);
+		ConstantPoolBuilder pool{ program.constants };
+
+		for (size_t i = 0; i < commands_size; i++)
+		{
+			const VMCommand& command = commands[i];
+			PackedCommand packed;
+			packed.operation = command.operation;
+
+			switch (command.operation)
+			{
+			case OpCode::OP_MOV_RI_INT:
+				if (fits_i32(command.immediate.i)) packed.source0 = static_cast<uint32_t>(static_cast<int32_t>(command.immediate.i));	//sign-extended by the vm
+				else
+				{
+					packed.operation = OpCode::OP_MOV_RC;
+					packed.source0 = pool.Add(command.immediate);
+				}
+				packed.destination = static_cast<uint32_t>(command.destination);
+				break;
+			case OpCode::OP_MOV_RI_UINT:
+				if (fits_u32(command.immediate.u)) packed.source0 = static_cast<uint32_t>(command.immediate.u);
+				else
+				{
+					packed.operation = OpCode::OP_MOV_RC;
+					packed.source0 = pool.Add(command.immediate);
+				}
+				packed.destination = static_cast<uint32_t>(command.destination);
+				break;
+			case OpCode::OP_MOV_RI_DOUBLE:
+				packed.operation = OpCode::OP_MOV_RC;
+				packed.destination = static_cast<uint32_t>(command.destination);
+				packed.source0 = pool.Add(command.immediate);
+				break;
+			case OpCode::OP_MOV_RC:		//Exists only in packed form
+				return VMError::VMCS_INVALID;
+			default:
+				if (IsEnclosingOpCode(command.operation))
+				{
+					uint64_t size = command.source1 >> 32;
+					uint64_t depth = command.source1 & 0xFFFFFFFF;
+					if (size > UINT8_MAX || depth > PACKED_DEPTH_MASK) return VMError::VMCS_INVALID;
+					if (!fits_u32(command.destination) || !fits_u32(command.source0)) return VMError::VMCS_INVALID;
+					packed.destination = static_cast<uint32_t>(command.destination);
+					packed.source0 = static_cast<uint32_t>(command.source0);
+					packed.source1 = static_cast<uint32_t>(size << PACKED_SIZE_SHIFT | depth);
+					break;
+				}
+				if (!fits_u32(command.destination) || !fits_u32(command.source0) || !fits_u32(command.source1)) return VMError::VMCS_INVALID;
+				packed.destination = static_cast<uint32_t>(command.destination);
+				packed.source0 = static_cast<uint32_t>(command.source0);
+				packed.source1 = static_cast<uint32_t>(command.source1);
+				break;
+			}
+			program.code.push_back(packed);
+		}
+		return VMError::NO_ERROR;
+	}
+}
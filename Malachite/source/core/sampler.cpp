@@ -0,0 +1,148 @@
+#include "../../include/core/sampler.h"
+#include <algorithm>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace MalachiteCore
+{
+	namespace
+	{
+		std::string frame_name(const VMProgram& program, uint64_t ip)
+		{
+			if (program.lines.empty()) return "ip " + std::to_string(ip);
+			uint32_t line = program.lines.line(ip);
+			return line == 0 ? std::string("?") : "line " + std::to_string(line);
+		}
+	}
+
+	void VMSamples::arm()
+	{
+		request.store(true, std::memory_order_relaxed);
+		std::lock_guard<std::mutex> lock(mutex);
+		if (sample_target == nullptr) return;
+		for (auto& entry : dispatch) entry.store(sample_target, std::memory_order_relaxed);
+	}
+
+	void VMSamples::enter(const void* const* table, const void* sample_target)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		disarm(table);
+		this->sample_target = sample_target;
+	}
+
+	void VMSamples::leave()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		sample_target = nullptr;
+	}
+
+	void VMSamples::disarm(const void* const* table)
+	{
+		//arm at the same time can leave some entries at sample_target, it gives one more sample
+		for (size_t i = 0; i < OperationListBlock::OPCODE_TABLE_SIZE; i++) dispatch[i].store(table[i], std::memory_order_relaxed);
+	}
+
+	void VMSamples::take(const VMState* state, uint64_t ip)
+	{
+		std::vector<uint64_t> stack;
+		stack.reserve(state->call_stack.size() + 1);
+		for (size_t i = 0; i < state->call_stack.size(); i++) stack.push_back(state->call_stack.at_unchecked(i).return_ip - 1);	//OP_CALL is before return ip
+		stack.push_back(ip);
+		stacks[std::move(stack)]++;
+		total++;
+	}
+
+	uint32_t VMSamples::next_skip()
+	{
+		random ^= random << 13;
+		random ^= random >> 7;
+		random ^= random << 17;
+		return static_cast<uint32_t>(random % SAMPLE_SKIP_WINDOW) + 1;
+	}
+
+	void VMSamples::clear()
+	{
+		stacks.clear();
+		total = 0;
+	}
+
+	void VMSampler::attach(VMSamples* samples)
+	{
+		if (samples == nullptr) return;
+		std::lock_guard<std::mutex> lock(mutex);
+		if (std::find(attached.begin(), attached.end(), samples) == attached.end()) attached.push_back(samples);
+	}
+
+	void VMSampler::detach(VMSamples* samples)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		attached.erase(std::remove(attached.begin(), attached.end(), samples), attached.end());
+	}
+
+	void VMSampler::start(std::chrono::microseconds period)
+	{
+		if (running()) return;
+		this->period = period.count() > 0 ? period : std::chrono::microseconds(1);
+		stopping = false;
+		thread = std::thread(&VMSampler::run, this);
+	}
+
+	void VMSampler::stop()
+	{
+		if (!running()) return;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		stop_condition.notify_all();
+		thread.join();
+	}
+
+	void VMSampler::run()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		auto next = std::chrono::steady_clock::now() + period;
+		while (!stop_condition.wait_until(lock, next, [this] { return stopping; }))
+		{
+			for (VMSamples* samples : attached) samples->arm();
+			next += period;
+			auto now = std::chrono::steady_clock::now();
+			if (next < now) next = now + period;	//Late wake up isnt caught up by a burst of requests
+		}
+	}
+
+	void dump_samples_flat(const VMSamples& samples, const VMProgram& program, std::ostream& out, size_t top_lines)
+	{
+		std::unordered_map<std::string, uint64_t> by_frame;
+		for (auto& [stack, count] : samples.stacks) by_frame[frame_name(program, stack.back())] += count;
+
+		std::vector<std::pair<std::string, uint64_t>> frames(by_frame.begin(), by_frame.end());
+		std::sort(frames.begin(), frames.end(), [](const auto& a, const auto& b) { return a.second != b.second ? a.second > b.second : a.first < b.first; });
+		out << "Samples: " << samples.total << "\n";
+		for (size_t i = 0; i < frames.size() && i < top_lines; i++)
+		{
+			out << "  " << frames[i].first << ": " << frames[i].second;
+			if (samples.total != 0) out << " (" << frames[i].second * 100 / samples.total << "%)";
+			out << "\n";
+		}
+	}
+
+	void dump_samples_folded(const VMSamples& samples, const VMProgram& program, std::ostream& out)
+	{
+		//Different ips of the same lines give the same folded stack, they are merged
+		std::map<std::string, uint64_t> folded;
+		for (auto& [stack, count] : samples.stacks)
+		{
+			std::string text;
+			for (uint64_t ip : stack)
+			{
+				if (!text.empty()) text += ';';
+				text += frame_name(program, ip);
+			}
+			folded[text] += count;
+		}
+		for (auto& [text, count] : folded) out << text << " " << count << "\n";
+	}
+}
@@ -0,0 +1,207 @@
+#include "../../include/core/scheduler.h"
+
+namespace MalachiteCore
+{
+	VMScheduler::VMScheduler(size_t workers_count, uint64_t slice_budget) : slice_budget(slice_budget == 0 ? 1 : slice_budget)
+	{
+		if (workers_count == 0) workers_count = std::thread::hardware_concurrency();
+		if (workers_count == 0) workers_count = 1;
+
+		workers.reserve(workers_count);
+		for (size_t i = 0; i < workers_count; i++) workers.push_back(std::make_unique<Worker>());
+		//Threads start after all deques exist: they steal from each other
+		for (size_t i = 0; i < workers_count; i++) workers[i]->thread = std::thread(&VMScheduler::run_worker, this, i);
+	}
+
+	VMScheduler::~VMScheduler()
+	{
+		{
+			std::lock_guard<std::mutex> lock(instances_mutex);
+			for (auto& p : instances) p.second->stop_request.store(true, std::memory_order_relaxed);
+		}
+		{
+			std::lock_guard<std::mutex> lock(idle_mutex);
+			shutting_down.store(true);
+		}
+		work_condition.notify_all();
+		for (auto& worker : workers)
+		{
+			if (worker->thread.joinable()) worker->thread.join();
+		}
+	}
+
+	void VMScheduler::set_completion_callback(CompletionCallback callback)
+	{
+		std::lock_guard<std::mutex> lock(instances_mutex);
+		completion_callback = std::move(callback);
+	}
+
+	InstanceID VMScheduler::submit(std::shared_ptr<const VMProgram> program, std::unique_ptr<VMState> state)
+	{
+		auto instance = std::make_shared<Instance>();
+		instance->program = std::move(program);
+		instance->state = state != nullptr ? std::move(state) : std::make_unique<VMState>();
+		{
+			std::lock_guard<std::mutex> lock(instances_mutex);
+			instance->id = next_id++;
+			instances.insert({ instance->id, instance });
+			unfinished++;
+		}
+		push(next_worker.fetch_add(1, std::memory_order_relaxed) % workers.size(), instance);
+		return instance->id;
+	}
+
+	void VMScheduler::stop(InstanceID id)
+	{
+		std::lock_guard<std::mutex> lock(instances_mutex);
+		auto it = instances.find(id);
+		if (it != instances.end()) it->second->stop_request.store(true, std::memory_order_relaxed);
+	}
+
+	InstanceResult VMScheduler::result(InstanceID id) const
+	{
+		std::lock_guard<std::mutex> lock(instances_mutex);
+		auto it = instances.find(id);
+		if (it == instances.end()) return InstanceResult{ InstanceStatus::FAILED, VMError::VMS_PTR_INVALID, 0 };
+		return it->second->result;
+	}
+
+	InstanceResult VMScheduler::wait(InstanceID id)
+	{
+		std::unique_lock<std::mutex> lock(instances_mutex);
+		auto it = instances.find(id);
+		if (it == instances.end()) return InstanceResult{ InstanceStatus::FAILED, VMError::VMS_PTR_INVALID, 0 };
+		auto instance = it->second;
+		finished_condition.wait(lock, [&] { return instance->result.status != InstanceStatus::ACTIVE; });
+		return instance->result;
+	}
+
+	void VMScheduler::wait_all()
+	{
+		std::unique_lock<std::mutex> lock(instances_mutex);
+		finished_condition.wait(lock, [&] { return unfinished == 0; });
+	}
+
+	std::unique_ptr<VMState> VMScheduler::take_state(InstanceID id)
+	{
+		std::lock_guard<std::mutex> lock(instances_mutex);
+		auto it = instances.find(id);
+		if (it == instances.end() || it->second->result.status == InstanceStatus::ACTIVE) return nullptr;
+		auto state = std::move(it->second->state);
+		instances.erase(it);
+		return state;
+	}
+
+	void VMScheduler::push(size_t worker, std::shared_ptr<Instance> instance)
+	{
+		queued.fetch_add(1);	//Before the deque: taker's fetch_sub cant go below zero
+		{
+			std::lock_guard<std::mutex> lock(workers[worker]->mutex);
+			workers[worker]->queue.push_back(std::move(instance));
+		}
+		if (sleeping.load() > 0) wake_one();
+	}
+
+	void VMScheduler::requeue(size_t worker, std::shared_ptr<Instance> instance)
+	{
+		size_t before = queued.fetch_add(1);
+		{
+			std::lock_guard<std::mutex> lock(workers[worker]->mutex);
+			workers[worker]->queue.push_back(std::move(instance));
+		}
+		//Queue was empty: the worker takes the instance back itself, nobody is woken
+		if (before > 0 && sleeping.load() > 0) wake_one();
+	}
+
+	void VMScheduler::wake_one()
+	{
+		//Worker between its check of queued and the wait holds idle_mutex: it cant miss the notification
+		{ std::lock_guard<std::mutex> lock(idle_mutex); }
+		work_condition.notify_one();
+	}
+
+	std::shared_ptr<VMScheduler::Instance> VMScheduler::take(size_t worker)
+	{
+		std::shared_ptr<Instance> instance;
+		{
+			std::lock_guard<std::mutex> lock(workers[worker]->mutex);
+			auto& queue = workers[worker]->queue;
+			if (!queue.empty())
+			{
+				instance = std::move(queue.front());
+				queue.pop_front();
+			}
+		}
+		//Steal from another workers, starting from the neighbour
+		for (size_t i = 1; instance == nullptr && i < workers.size(); i++)
+		{
+			auto& victim = *workers[(worker + i) % workers.size()];
+			std::lock_guard<std::mutex> lock(victim.mutex);
+			if (!victim.queue.empty())
+			{
+				instance = std::move(victim.queue.back());
+				victim.queue.pop_back();
+			}
+		}
+		if (instance != nullptr) queued.fetch_sub(1);
+		return instance;
+	}
+
+	void VMScheduler::run_worker(size_t worker)
+	{
+		for (;;)
+		{
+			auto instance = take(worker);
+			if (instance == nullptr)
+			{
+				std::unique_lock<std::mutex> lock(idle_mutex);
+				sleeping.fetch_add(1);	//Before the check of queued: push either sees the sleeper or is seen by it
+				work_condition.wait(lock, [&] { return queued.load() > 0 || shutting_down.load(); });
+				sleeping.fetch_sub(1);
+				if (shutting_down.load() && queued.load() == 0) return;
+				continue;
+			}
+			InstanceResult result;
+			if (run_slice(*instance, result)) complete(*instance, result);
+			else requeue(worker, std::move(instance));		//Yielded: back to the end of own queue
+		}
+	}
+
+	bool VMScheduler::run_slice(Instance& instance, InstanceResult& result)
+	{
+		VMState* state = instance.state.get();
+		VMError error = execute_slice(state, instance.program.get(), slice_budget, &instance.stop_request);
+		if (error == VMError::YIELD && !instance.stop_request.load(std::memory_order_relaxed)) return false;
+
+		result.error = error;
+		result.ip = state->ip;
+		switch (error)
+		{
+		case VMError::YIELD:
+			result.status = InstanceStatus::CANCELLED;
+			break;
+		case VMError::NO_ERROR:
+		case VMError::EXIT:
+			result.status = InstanceStatus::FINISHED;
+			break;
+		default:
+			result.status = InstanceStatus::FAILED;
+			if (!state->error_stack.empty()) result.ip = state->error_stack.top().ip;
+			break;
+		}
+		return true;
+	}
+
+	void VMScheduler::complete(Instance& instance, const InstanceResult& result)
+	{
+		CompletionCallback callback;
+		{
+			std::lock_guard<std::mutex> lock(instances_mutex);
+			instance.result = result;
+			unfinished--;
+			callback = completion_callback;
+		}
+		finished_condition.notify_all();
+		if (callback) callback(instance.id, result);
+	}
+}
@@ -0,0 +1,61 @@
+#include "../../include/core/snapshot.h"
+
+namespace MalachiteCore
+{
+	namespace
+	{
+		MemoryConfig config_of(const VMState& state)
+		{
+			MemoryConfig config;
+			config.heap_size = state.heap_end - HEAP_START + 1;
+			config.stack_size = state.stack_start - state.stack_end + 1;
+			config.huge_pages = false;	//Forks map the image pages
+			return config;
+		}
+
+		//Only written bytes are saved, another ones are zero in every VMState
+		std::vector<MemoryRange> dirty_ranges(const VMState& state)
+		{
+			std::vector<MemoryRange> ranges;
+			uint64_t heap_dirty = state.hp > state.heap_high_water ? state.hp : state.heap_high_water;
+			if (heap_dirty > HEAP_START) ranges.push_back({ HEAP_START, heap_dirty - HEAP_START });
+			if (state.stack_low_water < state.memory_size) ranges.push_back({ state.stack_low_water, state.memory_size - state.stack_low_water });
+			return ranges;
+		}
+	}
+
+	VMSnapshot::VMSnapshot(const VMState& state) :
+		m_config(config_of(state)),
+		m_memory(state.memory, state.memory_size, dirty_ranges(state)),
+		m_heap(state.heap),
+		m_ip(state.ip), m_sp(state.sp), m_hp(state.hp), m_fp(state.fp), m_flags(state.flags),
+		m_heap_high_water(state.heap_high_water), m_stack_low_water(state.stack_low_water),
+		m_call_stack(std::make_unique<CallStack>()), m_data_stack(std::make_unique<DataStack>()),
+		m_temp_data_stack(std::make_unique<DataStack>()), m_error_stack(std::make_unique<ErrorStack>())
+	{
+		for (size_t i = 0; i < REGISTER_COUNT; i++) m_registers[i] = state.registers[i];
+		m_call_stack->assign(state.call_stack);
+		m_data_stack->assign(state.data_stack);
+		m_temp_data_stack->assign(state.temp_data_stack);
+		m_error_stack->assign(state.error_stack);
+	}
+
+	std::unique_ptr<VMState> VMSnapshot::fork() const
+	{
+		auto state = std::make_unique<VMState>(m_config, VMMemory(m_memory));
+		for (size_t i = 0; i < REGISTER_COUNT; i++) state->registers[i] = m_registers[i];
+		state->ip = m_ip;
+		state->sp = m_sp;
+		state->hp = m_hp;
+		state->fp = m_fp;
+		state->flags = m_flags;
+		state->heap = m_heap;
+		state->heap_high_water = m_heap_high_water;
+		state->stack_low_water = m_stack_low_water;
+		state->call_stack.assign(*m_call_stack);
+		state->data_stack.assign(*m_data_stack);
+		state->temp_data_stack.assign(*m_temp_data_stack);
+		state->error_stack.assign(*m_error_stack);
+		return state;
+	}
+}
@@ -0,0 +1,76 @@
+#include "../../include/core/stats.h"
+#include <algorithm>
+#include <ostream>
+#include <utility>
+
+namespace MalachiteCore
+{
+	const char* get_operation_class_name(OperationClass operation_class)
+	{
+		switch (operation_class)
+		{
+		case OperationClass::ARITHMETIC: return "arithmetic";
+		case OperationClass::LOGIC: return "logic";
+		case OperationClass::MEMORY: return "memory";
+		case OperationClass::CONTROL_FLOW: return "control flow";
+		case OperationClass::SYSTEM_CALLS: return "system calls";
+		case OperationClass::TYPES_CONVERTION: return "types convertion";
+		default: return "other";
+		}
+	}
+
+	void VMStats::clear()
+	{
+		profile = VMProfile();
+		std::fill(ips.begin(), ips.end(), 0);
+		std::fill(std::begin(class_time), std::end(class_time), 0);
+		std::fill(std::begin(class_timed), std::end(class_timed), 0);
+		runs = 0;
+		run_time = 0;
+	}
+
+	void dump_stats(const VMStats& stats, std::ostream& out, size_t top_ips, OpCodeNameFunction name)
+	{
+		uint64_t total = stats.profile.total();
+		out << "Runs: " << stats.runs << ", time: " << stats.run_time / 1000 << " us, commands: " << total << "\n";
+
+		std::vector<std::pair<uint64_t, uint16_t>> operations;
+		for (uint16_t code = 0; code < OperationListBlock::OPCODE_TABLE_SIZE; code++)
+		{
+			if (stats.profile.commands[code] != 0) operations.push_back({ stats.profile.commands[code], code });
+		}
+		std::sort(operations.begin(), operations.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+		out << "Operations:\n";
+		for (auto& [count, code] : operations)
+		{
+			out << "  " << (name != nullptr ? name(static_cast<OpCode>(code)) : std::to_string(code)) << ": " << count;
+			if (total != 0) out << " (" << count * 100 / total << "%)";
+			out << "\n";
+		}
+
+		bool timed = false;
+		for (uint64_t count : stats.class_timed) timed |= count != 0;
+		if (timed)
+		{
+			out << "Classes (timed commands, average ticks):\n";
+			for (size_t i = 0; i < OPERATION_CLASS_COUNT; i++)
+			{
+				if (stats.class_timed[i] == 0) continue;
+				out << "  " << get_operation_class_name(static_cast<OperationClass>(i)) << ": " << stats.class_timed[i] << ", " << stats.class_time[i] / stats.class_timed[i] << "\n";
+			}
+		}
+
+		std::vector<std::pair<uint64_t, size_t>> hot;
+		for (size_t ip = 0; ip < stats.ips.size(); ip++)
+		{
+			if (stats.ips[ip] != 0) hot.push_back({ stats.ips[ip], ip });
+		}
+		size_t count = std::min(top_ips, hot.size());
+		std::partial_sort(hot.begin(), hot.begin() + count, hot.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+		if (count > 0) out << "Hottest ips:\n";
+		for (size_t i = 0; i < count; i++)
+		{
+			out << "  " << hot[i].second << ": " << hot[i].first << "\n";
+		}
+	}
+}
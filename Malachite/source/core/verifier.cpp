@@ -0,0 +1,325 @@
+#include "../../include/core/verifier.h"
+#include <optional>
+#include <unordered_map>
+
+namespace MalachiteCore
+{
+	namespace
+	{
+		constexpr uint64_t NO_FUNCTION = UINT64_MAX;
+
+		//Program's code: depths from stack start, level 0 - outside of frames.
+		//Function's body: depths from sp of the call (any caller), level 0 - callee's frame made by OP_CALL
+		struct FrameLayout
+		{
+			std::vector<uint64_t> frames{ 0 };	//Depth of every frame level
+			uint64_t depth = 0;					//Depth of sp
+			uint64_t function = NO_FUNCTION;	//Entry of the function whose body it is
+
+			bool operator==(const FrameLayout& other) const = default;
+			uint64_t level() const { return frames.size() - 1; }
+		};
+
+		struct FunctionInfo
+		{
+			uint64_t frame_size = 0;	//OP_CALL source0, the same for every call
+			uint64_t stack_size = 0;	//Stack bytes used by the body from sp of the call, nested calls check their own
+		};
+
+		inline bool is_register_role(OperandRole role)
+		{
+			return role == ROLE_READ || role == ROLE_WRITE || role == ROLE_READ_WRITE;
+		}
+
+		//Size of memory access in bytes, 0 for commands without memory access
+		uint64_t access_size(const VMCommand& command)
+		{
+			uint64_t width = GetOpCodeWidth(command.operation);
+			if (width != 0) return width;
+			switch (command.operation)
+			{
+			case OP_LOAD_RM: case OP_STORE_MR: case OP_LOAD_LOCAL: case OP_STORE_LOCAL: case OP_LOAD_STACK: case OP_STORE_STACK: return command.source1;
+			case OP_PUSH: return command.destination;
+			case OP_POP: return command.source0;
+			case OP_STORE_ENCLOSING_A: case OP_LOAD_ENCLOSING_A: case OP_STORE_ENCLOSING_R: case OP_LOAD_ENCLOSING_R: return command.source1 >> 32;
+			default: return 0;
+			}
+		}
+
+		class Verifier
+		{
+		public:
+			Verifier(const VMCommand* commands, size_t commands_size, ProgramVerification& result) :
+				commands(commands), commands_size(commands_size), result(result), layouts(commands_size) {}
+
+			VMError Run()
+			{
+				result = ProgramVerification();
+				VMError error = Propagate(0, FrameLayout());
+				while (error == VMError::NO_ERROR && !worklist.empty())
+				{
+					uint64_t ip = worklist.back();
+					worklist.pop_back();
+					error = Check(ip);
+					if (error != VMError::NO_ERROR) result.failed_ip = ip;
+				}
+				for (auto& function : functions)
+				{
+					if (error == VMError::NO_ERROR && function.second.stack_size > UINT32_MAX) error = VMError::STACK_OVERFLOW;	//Doesnt fit into OP_CALL source1
+				}
+				result.verified = error == VMError::NO_ERROR;
+				if (!result.verified)
+				{
+					result.memory_size = 0;
+					result.stack_size = 0;
+					result.host_functions = 0;
+				}
+				return error;
+			}
+
+			//Unchecked loop checks stack of a call by the whole use of the callee: OP_CALL source1
+			void ResolveCalls(std::vector<PackedCommand>& code) const
+			{
+				for (size_t ip = 0; ip < commands_size; ip++)
+				{
+					if (!layouts[ip].has_value() || commands[ip].operation != OP_CALL) continue;
+					code[ip].source1 = static_cast<uint32_t>(functions.at(commands[ip].destination).stack_size);
+				}
+			}
+
+			//Frame depths of the program's code are known: enclosing accesses become accesses at fixed depth from stack start.
+			//Depths in function bodies depend on the caller, they stay
+			uint64_t ResolveFrames(std::vector<PackedCommand>& code) const
+			{
+				uint64_t resolved = 0;
+				for (size_t ip = 0; ip < commands_size; ip++)
+				{
+					const VMCommand& command = commands[ip];
+					if (!layouts[ip].has_value() || layouts[ip]->function != NO_FUNCTION || !IsEnclosingOpCode(command.operation)) continue;
+					uint64_t depth = layouts[ip]->frames[EnclosingFrame(command, *layouts[ip])] + EnclosingOffset(command);
+					if (depth > UINT32_MAX) continue;
+					uint64_t size = access_size(command);
+					PackedCommand& packed = code[ip];
+					if (IsEnclosingStore(command))
+					{
+						packed.operation = GetWidthOpCode(OP_STORE_STACK, size);
+						packed.destination = static_cast<uint32_t>(depth);
+					}
+					else
+					{
+						packed.operation = GetWidthOpCode(OP_LOAD_STACK, size);
+						packed.source0 = static_cast<uint32_t>(depth);
+					}
+					packed.source1 = static_cast<uint32_t>(size);
+					resolved++;
+				}
+				return resolved;
+			}
+		private:
+			const VMCommand* commands;
+			size_t commands_size;
+			ProgramVerification& result;
+			std::vector<std::optional<FrameLayout>> layouts;
+			std::vector<uint64_t> worklist;
+			std::unordered_map<uint64_t, FunctionInfo> functions;	//By entry
+
+			//Stack bytes [stack_start - depth, stack_start] are used, in a function body - [sp of the call - depth, sp of the call]
+			void NeedStack(const FrameLayout& layout, uint64_t depth)
+			{
+				uint64_t& size = layout.function == NO_FUNCTION ? result.stack_size : functions[layout.function].stack_size;
+				if (depth + 1 > size) size = depth + 1;
+			}
+			void NeedStack(uint64_t depth) { if (depth + 1 > result.stack_size) result.stack_size = depth + 1; }	//Absolute: OP_LOAD_STACK/OP_STORE_STACK
+			void NeedMemory(uint64_t end) { if (end > result.memory_size) result.memory_size = end; }
+			void NeedHost(uint64_t index) { if (index + 1 > result.host_functions) result.host_functions = index + 1; }
+
+			//ip == commands_size is the end of program
+			VMError Propagate(uint64_t ip, const FrameLayout& layout)
+			{
+				if (ip > commands_size) return VMError::VMCS_INVALID;
+				if (ip == commands_size) return VMError::NO_ERROR;
+				auto& known = layouts[ip];
+				if (known.has_value()) return *known == layout ? VMError::NO_ERROR : VMError::VMCS_INVALID;
+				known = layout;
+				worklist.push_back(ip);
+				return VMError::NO_ERROR;
+			}
+
+			//Data stack keeps fp of levels [0, level), level n is at index n in the program's code.
+			//In a function body data stack frames below the callee's ones belong to the caller: only relative access to the body's levels
+			static uint64_t EnclosingFrame(const VMCommand& command, const FrameLayout& layout)
+			{
+				OpCode generic = GetGenericOpCode(command.operation);
+				uint64_t depth = command.source1 & 0xFFFFFFFF;
+				return generic == OP_STORE_ENCLOSING_A || generic == OP_LOAD_ENCLOSING_A ? depth : layout.level() - 1 - depth;
+			}
+			static bool IsEnclosingStore(const VMCommand& command)
+			{
+				OpCode generic = GetGenericOpCode(command.operation);
+				return generic == OP_STORE_ENCLOSING_A || generic == OP_STORE_ENCLOSING_R;
+			}
+			static uint64_t EnclosingOffset(const VMCommand& command)
+			{
+				return IsEnclosingStore(command) ? command.destination : command.source0;
+			}
+
+			VMError CheckFrameAccess(const FrameLayout& layout, uint64_t frame, uint64_t offset, uint64_t size)
+			{
+				if (offset > UINT32_MAX) return VMError::MEMORY_ACCESS_VIOLATION;
+				NeedStack(layout, layout.frames[frame] + offset + size);
+				return VMError::NO_ERROR;
+			}
+
+			VMError Check(uint64_t ip)
+			{
+				const VMCommand& command = commands[ip];
+				FrameLayout layout = *layouts[ip];
+				OpCode generic = GetGenericOpCode(command.operation);
+
+				OperandRoles roles = GetOperandRoles(command.operation);
+				if (is_register_role(roles.destination) && command.destination >= REGISTER_COUNT) return VMError::VMCS_INVALID;
+				if (is_register_role(roles.source0) && command.source0 >= REGISTER_COUNT) return VMError::VMCS_INVALID;
+				if (is_register_role(roles.source1) && command.source1 >= REGISTER_COUNT) return VMError::VMCS_INVALID;
+
+				uint64_t size = access_size(command);
+				switch (generic)
+				{
+				case OP_LOAD_RM: case OP_STORE_MR: case OP_LOAD_LOCAL: case OP_STORE_LOCAL: case OP_LOAD_STACK: case OP_STORE_STACK: case OP_PUSH: case OP_POP:
+				case OP_STORE_ENCLOSING_A: case OP_LOAD_ENCLOSING_A: case OP_STORE_ENCLOSING_R: case OP_LOAD_ENCLOSING_R:
+					if (size == 0 || size > REGISTER_SIZE) return VMError::MEMORY_ACCESS_VIOLATION;
+					break;
+				default:
+					break;
+				}
+
+				switch (generic)
+				{
+				case OP_NOP:
+				case OP_IADD_RRR: case OP_ISUB_RRR: case OP_IMUL_RRR: case OP_IDIV_RRR: case OP_IMOD_RRR: case OP_INEG_RR:
+				case OP_UADD_RRR: case OP_USUB_RRR: case OP_UMUL_RRR: case OP_UDIV_RRR: case OP_UMOD_RRR:
+				case OP_DADD_RRR: case OP_DSUB_RRR: case OP_DMUL_RRR: case OP_DDIV_RRR: case OP_DNEG_RR:
+				case OP_AND_RRR: case OP_OR_RRR: case OP_NOT_RR: case OP_BIT_OR_RRR: case OP_BIT_NOT_RR: case OP_BIT_AND_RRR:
+				case OP_BIT_OFFSET_LEFT_RRR: case OP_BIT_OFFSET_RIGHT_RRR: case OP_CMP_RR: case OP_DCMP_RR: case OP_GET_FLAG:
+				case OP_MOV_RR: case OP_MOV_RI_INT: case OP_MOV_RI_UINT: case OP_MOV_RI_DOUBLE:
+				case OP_ALLOCATE_MEMORY: case OP_FREE_MEMORY: case OP_SYSTEM_CALL:
+				case OP_TC_ITD_R: case OP_TC_DTI_R: case OP_TC_UITD_R: case OP_TC_UITI_R: case OP_TC_DTUI_R: case OP_TC_ITUI_R:
+					break;
+				case OP_CALL_HOST:
+					if (command.destination > UINT32_MAX || command.source1 > REGISTER_COUNT - command.source0) return VMError::VMCS_INVALID;
+					NeedHost(command.destination);
+					break;
+				case OP_LOAD_RM:
+					if (command.source0 > UINT32_MAX) return VMError::MEMORY_ACCESS_VIOLATION;
+					NeedMemory(command.source0 + size);
+					break;
+				case OP_STORE_MR:
+					if (command.destination > UINT32_MAX) return VMError::MEMORY_ACCESS_VIOLATION;
+					NeedMemory(command.destination + size);
+					break;
+				case OP_CREATE_FRAME:
+					if (layout.level() >= CALL_STACK_SIZE) return VMError::STACK_OVERFLOW;
+					layout.frames.push_back(layout.depth);
+					layout.depth += command.destination;
+					NeedStack(layout, layout.depth);
+					break;
+				case OP_DESTROY_FRAME:
+					if (layout.level() == 0) return VMError::STACK_UNDERFLOW;	//Callee's frame is destroyed by OP_RET
+					layout.depth = layout.frames.back();
+					layout.frames.pop_back();
+					break;
+				case OP_DESTROY_FRAMES:
+					if (command.destination > layout.level()) return VMError::STACK_UNDERFLOW;
+					if (command.destination == 0) break;
+					layout.depth = layout.frames[layout.level() - command.destination + 1];
+					layout.frames.resize(layout.level() - command.destination + 1);
+					break;
+				case OP_PUSH:
+					layout.depth += size;
+					NeedStack(layout, layout.depth);
+					break;
+				case OP_POP:
+					if (layout.depth < layout.frames.back() + size) return VMError::STACK_UNDERFLOW;	//Pops dont go below the current frame
+					layout.depth -= size;
+					break;
+				case OP_LOAD_LOCAL:
+				{
+					VMError error = CheckFrameAccess(layout, layout.level(), command.source0, size);
+					if (error != VMError::NO_ERROR) return error;
+					break;
+				}
+				case OP_STORE_LOCAL:
+				{
+					VMError error = CheckFrameAccess(layout, layout.level(), command.destination, size);
+					if (error != VMError::NO_ERROR) return error;
+					break;
+				}
+				case OP_LOAD_STACK:
+					if (command.source0 > UINT32_MAX) return VMError::MEMORY_ACCESS_VIOLATION;
+					NeedStack(command.source0 + size);
+					break;
+				case OP_STORE_STACK:
+					if (command.destination > UINT32_MAX) return VMError::MEMORY_ACCESS_VIOLATION;
+					NeedStack(command.destination + size);
+					break;
+				case OP_STORE_ENCLOSING_A: case OP_LOAD_ENCLOSING_A: case OP_STORE_ENCLOSING_R: case OP_LOAD_ENCLOSING_R:
+				{
+					if ((command.source1 & 0xFFFFFFFF) >= layout.level()) return VMError::STACK_UNDERFLOW;
+					if (layout.function != NO_FUNCTION && (generic == OP_STORE_ENCLOSING_A || generic == OP_LOAD_ENCLOSING_A)) return VMError::VMCS_INVALID;	//Data stack index depends on the caller
+					VMError error = CheckFrameAccess(layout, EnclosingFrame(command, layout), EnclosingOffset(command), size);
+					if (error != VMError::NO_ERROR) return error;
+					break;
+				}
+				case OP_JMP:
+					return Propagate(command.destination, layout);
+				case OP_JMP_CV: case OP_JMP_CNV:
+				case OP_JMP_IEQ: case OP_JMP_INE: case OP_JMP_IGT: case OP_JMP_ILT: case OP_JMP_IGE: case OP_JMP_ILE:
+				case OP_JMP_DEQ: case OP_JMP_DNE: case OP_JMP_DGT: case OP_JMP_DLT: case OP_JMP_DGE: case OP_JMP_DLE:
+				{
+					VMError error = Propagate(command.destination, layout);
+					if (error != VMError::NO_ERROR) return error;
+					break;
+				}
+				case OP_CALL:
+				{
+					//Body is checked once for all calls: from its own frame. Call depth and stack of the call are checked by OP_CALL at run
+					auto [function, added] = functions.try_emplace(command.destination, FunctionInfo{ command.source0, 0 });
+					if (function->second.frame_size != command.source0) return VMError::VMCS_INVALID;
+					if (added)
+					{
+						FrameLayout body;
+						body.depth = command.source0;
+						body.function = command.destination;
+						NeedStack(body, body.depth);
+						VMError error = Propagate(command.destination, body);
+						if (error != VMError::NO_ERROR) return error;
+					}
+					break;	//Caller continues with its layout: OP_RET restores sp and fp
+				}
+				case OP_RET:
+					if (layout.function == NO_FUNCTION) return VMError::STACK_UNDERFLOW;
+					if (layout.level() != 0) return VMError::VMCS_INVALID;	//Frames created in the callee have to be destroyed before
+					return VMError::NO_ERROR;	//Returns to any caller, it continues by its OP_CALL
+				case OP_HALT:
+					return VMError::NO_ERROR;	//Run resumed after HALT keeps runtime checks, the next command is reached from here only that way
+				default:
+					return VMError::VMCS_INVALID;	//OP_MOV_RC and unknown operations
+				}
+				return Propagate(ip + 1, layout);
+			}
+		};
+	}
+
+	VMError verify_program(const VMCommand* commands, size_t commands_size, VMProgram& program)
+	{
+		program.verification = ProgramVerification();
+		if (commands == nullptr || commands_size == 0 || program.code.size() != commands_size) return VMError::VMCS_INVALID;
+		Verifier verifier(commands, commands_size, program.verification);
+		VMError result = verifier.Run();
+		if (result == VMError::NO_ERROR)
+		{
+			verifier.ResolveCalls(program.code);
+			program.verification.resolved_accesses = verifier.ResolveFrames(program.code);
+		}
+		return result;
+	}
+}
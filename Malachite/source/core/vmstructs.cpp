@@ -0,0 +1,251 @@
+#include "../../include/core/vmstructs.h"
+#include <bit>
+
+namespace MalachiteCore
+{
+	namespace
+	{
+		constexpr size_t WORD_BITS = 64;
+
+		inline bool test_bit(const std::vector<uint64_t>& bits, size_t index)
+		{
+			return index / WORD_BITS < bits.size() && (bits[index / WORD_BITS] >> (index % WORD_BITS)) & 1;
+		}
+
+		inline void set_bit(std::vector<uint64_t>& bits, size_t index, bool value)
+		{
+			uint64_t mask = 1ull << (index % WORD_BITS);
+			if (value) bits[index / WORD_BITS] |= mask;
+			else bits[index / WORD_BITS] &= ~mask;
+		}
+
+		//Whole words are filled at once, only edge words are masked
+		void set_range(std::vector<uint64_t>& bits, size_t first, size_t count, bool value)
+		{
+			while (count > 0)
+			{
+				size_t offset = first % WORD_BITS;
+				size_t length = WORD_BITS - offset < count ? WORD_BITS - offset : count;
+				uint64_t mask = (length == WORD_BITS ? ~0ull : ((1ull << length) - 1)) << offset;
+				if (value) bits[first / WORD_BITS] |= mask;
+				else bits[first / WORD_BITS] &= ~mask;
+				first += length;
+				count -= length;
+			}
+		}
+
+		//First index >= from with the bit equal to value, bits.size() * WORD_BITS if there isnt
+		size_t find_bit(const std::vector<uint64_t>& bits, size_t from, bool value)
+		{
+			size_t word = from / WORD_BITS;
+			if (word >= bits.size()) return bits.size() * WORD_BITS;
+			uint64_t current = (value ? bits[word] : ~bits[word]) & (~0ull << (from % WORD_BITS));
+			while (current == 0)
+			{
+				if (++word == bits.size()) return bits.size() * WORD_BITS;
+				current = value ? bits[word] : ~bits[word];
+			}
+			return word * WORD_BITS + std::countr_zero(current);
+		}
+
+		//Index after the highest set bit below before, 0 if there isnt
+		size_t find_top(const std::vector<uint64_t>& bits, size_t before)
+		{
+			size_t word = before / WORD_BITS;
+			uint64_t current = before % WORD_BITS != 0 ? bits[word] & ((1ull << (before % WORD_BITS)) - 1) : 0;
+			while (current == 0)
+			{
+				if (word == 0) return 0;
+				current = bits[--word];
+			}
+			return word * WORD_BITS + (WORD_BITS - std::countl_zero(current));
+		}
+	}
+
+	HeapMemoryAllocator::HeapMemoryAllocator(size_t heap_size) : m_granules(heap_size / HEAP_GRANULE)
+	{
+		reset();
+	}
+
+	void HeapMemoryAllocator::reset()
+	{
+		m_used.assign(1, 0);
+		m_ends.assign(1, 0);
+		m_cached.assign(1, 0);
+		for (auto& list : m_classes) list.clear();
+		m_top = 0;
+		m_first_free_word = 0;
+		if (m_granules > 0)	//Granule 0 is a reserved block: address 0 means "no block"
+		{
+			m_used[0] = 1;
+			m_ends[0] = 1;
+			m_top = 1;
+		}
+		m_used_granules = 0;
+		m_cached_granules = 0;
+		m_peak_granules = 0;
+		m_allocations = 0;
+		m_frees = 0;
+		m_failed_allocations = 0;
+		m_size_class_hits = 0;
+	}
+
+	uint64_t HeapMemoryAllocator::allocate(size_t size)
+	{
+		size_t count = size / HEAP_GRANULE + (size % HEAP_GRANULE != 0);
+		if (count == 0 || count >= m_granules)
+		{
+			m_failed_allocations++;
+			return 0;
+		}
+		size_t granule;
+		if (count <= HEAP_SIZE_CLASSES && !m_classes[count - 1].empty())
+		{
+			granule = m_classes[count - 1].back() / HEAP_GRANULE;
+			m_classes[count - 1].pop_back();
+			set_bit(m_cached, granule, false);
+			m_cached_granules -= count;
+			m_size_class_hits++;
+		}
+		else
+		{
+			granule = find_free(count);
+			if (granule == m_granules && m_cached_granules > 0)
+			{
+				flush_size_classes();
+				granule = find_free(count);
+			}
+			if (granule == m_granules)
+			{
+				m_failed_allocations++;
+				return 0;
+			}
+			take(granule, count);
+		}
+		m_used_granules += count;
+		if (m_used_granules > m_peak_granules) m_peak_granules = m_used_granules;
+		m_allocations++;
+		return granule * HEAP_GRANULE;
+	}
+
+	bool HeapMemoryAllocator::free(uint64_t pointer)
+	{
+		if (pointer % HEAP_GRANULE != 0) return false;
+		size_t granule = pointer / HEAP_GRANULE;
+		if (granule == 0 || granule >= m_top || !is_block_start(granule)) return false;
+
+		size_t count = block_granules(granule);
+		m_used_granules -= count;
+		m_frees++;
+		if (count <= HEAP_SIZE_CLASSES)
+		{
+			m_classes[count - 1].push_back(pointer);
+			set_bit(m_cached, granule, true);
+			m_cached_granules += count;
+		}
+		else release(granule, count);
+		return true;
+	}
+
+	size_t HeapMemoryAllocator::block_size(uint64_t pointer) const
+	{
+		if (pointer % HEAP_GRANULE != 0) return 0;
+		size_t granule = pointer / HEAP_GRANULE;
+		if (granule == 0 || granule >= m_top || !is_block_start(granule)) return 0;
+		return block_granules(granule) * HEAP_GRANULE;
+	}
+
+	HeapStats HeapMemoryAllocator::stats() const
+	{
+		HeapStats stats;
+		stats.heap_size = heap_size();
+		stats.used_bytes = m_used_granules * HEAP_GRANULE;
+		stats.cached_bytes = m_cached_granules * HEAP_GRANULE;
+		stats.free_bytes = m_granules > 0 ? (m_granules - 1 - m_used_granules - m_cached_granules) * HEAP_GRANULE : 0;
+		stats.peak_used_bytes = m_peak_granules * HEAP_GRANULE;
+		stats.top = top();
+		stats.allocations = m_allocations;
+		stats.frees = m_frees;
+		stats.failed_allocations = m_failed_allocations;
+		stats.size_class_hits = m_size_class_hits;
+
+		//Free runs inside bitmap, the last one continues to the end of heap
+		size_t largest = 0;
+		size_t run = 0;
+		for (size_t granule = 0; granule < m_top; granule++)
+		{
+			if (test_bit(m_used, granule)) run = 0;
+			else if (++run > largest) largest = run;
+		}
+		if (m_granules - m_top + run > largest) largest = m_granules - m_top + run;
+		stats.largest_free_block = largest * HEAP_GRANULE;
+		return stats;
+	}
+
+	bool HeapMemoryAllocator::is_block_start(size_t granule) const
+	{
+		if (!test_bit(m_used, granule) || test_bit(m_cached, granule)) return false;
+		return !test_bit(m_used, granule - 1) || test_bit(m_ends, granule - 1);
+	}
+
+	size_t HeapMemoryAllocator::block_granules(size_t granule) const
+	{
+		size_t word = granule / WORD_BITS;
+		uint64_t bits = m_ends[word] & (~0ull << (granule % WORD_BITS));
+		while (bits == 0) bits = m_ends[++word];	//Every block in bitmap has its end bit
+		return word * WORD_BITS + std::countr_zero(bits) - granule + 1;
+	}
+
+	//First fit: returns first granule of a free run with count granules or m_granules
+	size_t HeapMemoryAllocator::find_free(size_t count) const
+	{
+		size_t start = find_bit(m_used, m_first_free_word * WORD_BITS, false);
+		for (;;)
+		{
+			if (start + count > m_granules) return m_granules;
+			size_t end = find_bit(m_used, start, true);
+			if (end == m_used.size() * WORD_BITS || end - start >= count) return start;	//Run after the last used granule is open up to the end of heap
+			start = find_bit(m_used, end, false);
+		}
+	}
+
+	void HeapMemoryAllocator::take(size_t granule, size_t count)
+	{
+		if (granule + count > m_top)
+		{
+			m_top = granule + count;
+			size_t words = (m_top + WORD_BITS - 1) / WORD_BITS;
+			if (words > m_used.size())
+			{
+				m_used.resize(words, 0);
+				m_ends.resize(words, 0);
+				m_cached.resize(words, 0);
+			}
+		}
+		set_range(m_used, granule, count, true);
+		set_bit(m_ends, granule + count - 1, true);
+		while (m_first_free_word < m_used.size() && m_used[m_first_free_word] == ~0ull) m_first_free_word++;
+	}
+
+	void HeapMemoryAllocator::release(size_t granule, size_t count)
+	{
+		set_range(m_used, granule, count, false);
+		set_bit(m_ends, granule + count - 1, false);
+		if (granule / WORD_BITS < m_first_free_word) m_first_free_word = granule / WORD_BITS;
+		if (granule + count == m_top) m_top = find_top(m_used, granule);	//Granule 0 is always used, top doesnt reach 0
+	}
+
+	void HeapMemoryAllocator::flush_size_classes()
+	{
+		for (size_t i = 0; i < HEAP_SIZE_CLASSES; i++)
+		{
+			for (uint64_t pointer : m_classes[i])
+			{
+				set_bit(m_cached, pointer / HEAP_GRANULE, false);
+				release(pointer / HEAP_GRANULE, i + 1);
+			}
+			m_classes[i].clear();
+		}
+		m_cached_granules = 0;
+	}
+}